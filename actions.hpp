@@ -0,0 +1,365 @@
+//------------------------------------------------------------------------------
+//
+//  Orbits under arbitrary actions
+//
+//------------------------------------------------------------------------------
+//
+// Orbits in orbits.hpp are orbits of single points of domain T, where action
+// is just Perm::apply. ActionOrbit is the same Schreier vector orbit for any
+// point type and action, given by functor
+//
+//   Point operator()(const Point &p, const Perm &g) const; // p^g
+//
+// It shall be right action: act(act(p, a), b) == act(p, product(a, b))
+//
+// Predefined actions:
+//
+// OnPoints<T>: points of T, same as plain orbits
+// OnPairs<T>: ordered pairs (x, y), i.e. orbitals of group
+// OnTuples<T>: vectors of points, taken componentwise
+// OnSets<T>: sorted vectors of distinct points, so k-subsets. Image is sorted
+//            again
+//
+// Action may also have
+//
+//   Point normalize(Point p) const;
+//
+// applied to starting point, so it is in the same form as images. OnSets
+// sorts starting set and throws invalid_argument if points repeat
+//
+// Orbit points are kept in BFS queue, for every point Schreier vector keeps
+// number of its generator and position of its parent. Points are looked up
+// either in table, indexed by point rank, if action has
+//
+//   size_t rank(const Point &p) const;    // in [0, rank_size())
+//   size_t rank_size() const;
+//
+// (OnPoints and OnPairs have it), and rank_size() is at most
+// max_rank_table, or in FlatMap, using PointHash otherwise. So table costs
+// at most 4 * max_rank_table bytes even for small orbit, and say orbitals
+// of big degree are hashed. ubeta and sift never apply action, only uword
+// trace does.
+//
+//------------------------------------------------------------------------------
+
+#ifndef ACTIONS_GUARD_
+#define ACTIONS_GUARD_
+
+#include <type_traits>
+
+#include "orbits.hpp"
+
+namespace orbits {
+
+//------------------------------------------------------------------------------
+//
+// Actions and point hashes
+//
+//------------------------------------------------------------------------------
+
+template <typename T> struct OnPoints {
+  template <typename Perm> T operator()(T x, const Perm &g) const {
+    return g.apply(x);
+  }
+  size_t rank(T x) const { return x - T::start; }
+  size_t rank_size() const { return T::fin - T::start + 1; }
+};
+
+template <typename T> struct OnPairs {
+  using point_t = pair<T, T>;
+  template <typename Perm>
+  point_t operator()(const point_t &p, const Perm &g) const {
+    return {g.apply(p.first), g.apply(p.second)};
+  }
+  size_t rank(const point_t &p) const {
+    return (p.first - T::start) * (T::fin - T::start + 1) +
+           (p.second - T::start);
+  }
+  size_t rank_size() const {
+    return (T::fin - T::start + 1) * (T::fin - T::start + 1);
+  }
+};
+
+template <typename T> struct OnTuples {
+  template <typename Perm>
+  vector<T> operator()(const vector<T> &p, const Perm &g) const {
+    vector<T> res(p.size());
+    for (size_t i = 0; i != p.size(); ++i)
+      res[i] = g.apply(p[i]);
+    return res;
+  }
+};
+
+template <typename T> struct OnSets {
+  template <typename Perm>
+  vector<T> operator()(const vector<T> &p, const Perm &g) const {
+    auto res = OnTuples<T>{}(p, g);
+    sort(res.begin(), res.end());
+    return res;
+  }
+  vector<T> normalize(vector<T> p) const {
+    sort(p.begin(), p.end());
+    if (adjacent_find(p.begin(), p.end()) != p.end())
+      throw invalid_argument("set shall not have repeating points");
+    return p;
+  }
+};
+
+// hash of orbit points: domain points, pairs and vectors of them, or
+// std::hash for anything else
+template <typename Point> struct PointHash {
+  size_t operator()(const Point &p) const {
+    if constexpr (std::is_convertible_v<Point, long long>)
+      return mix_hash(static_cast<long long>(p));
+    else
+      return std::hash<Point>{}(p);
+  }
+};
+
+template <typename T> struct PointHash<pair<T, T>> {
+  size_t operator()(const pair<T, T> &p) const {
+    PointHash<T> hf;
+    return mix_hash(hf(p.first) * 31 + hf(p.second));
+  }
+};
+
+template <typename T> struct PointHash<vector<T>> {
+  size_t operator()(const vector<T> &p) const {
+    PointHash<T> hf;
+    size_t h = p.size();
+    for (auto &&x : p)
+      h = mix_hash(h ^ hf(x));
+    return h;
+  }
+};
+
+// action has rank and rank_size
+template <typename Action, typename Point, typename = void>
+struct is_ranked_action : std::false_type {};
+
+template <typename Action, typename Point>
+struct is_ranked_action<
+    Action, Point,
+    std::void_t<decltype(std::declval<const Action &>().rank(
+        std::declval<const Point &>()))>> : std::true_type {};
+
+// action has normalize
+template <typename Action, typename Point, typename = void>
+struct is_normalizing_action : std::false_type {};
+
+template <typename Action, typename Point>
+struct is_normalizing_action<
+    Action, Point,
+    std::void_t<decltype(std::declval<const Action &>().normalize(
+        std::declval<Point>()))>> : std::true_type {};
+
+// biggest rank table, bigger ranks go to hash
+constexpr size_t max_rank_table = size_t(1) << 22;
+
+//------------------------------------------------------------------------------
+//
+// Orbit
+//
+//------------------------------------------------------------------------------
+
+template <typename Point, typename Perm, typename Action,
+          typename Hash = PointHash<Point>>
+class ActionOrbit {
+  static constexpr bool ranked = is_ranked_action<Action, Point>::value;
+  static constexpr uint32_t npos = static_cast<uint32_t>(-1);
+
+  Action act_;
+  vector<Point> points_;
+
+  // generator number + 1 (0 for root) and parent position for every point
+  vector<uint32_t> label_;
+  vector<uint32_t> parent_;
+
+  // point positions: by rank or by hash, whatever action supports
+  bool use_table_ = false;
+  vector<uint32_t> table_;
+  FlatMap<Point, uint32_t, Hash> index_;
+
+  vector<Perm> gens_;
+  vector<Perm> invgens_;
+
+public:
+  using type = Point;
+
+  template <typename GenIter>
+  ActionOrbit(Point p, GenIter gensbeg, GenIter gensend, Action act = Action{})
+      : act_(act) {
+    if constexpr (ranked) {
+      use_table_ = (act_.rank_size() <= max_rank_table);
+      if (use_table_)
+        table_.assign(act_.rank_size(), npos);
+    }
+    if constexpr (is_normalizing_action<Action, Point>::value)
+      p = act_.normalize(move(p));
+    gens_.assign(gensbeg, gensend);
+    transform(gens_.begin(), gens_.end(), back_inserter(invgens_),
+              [](const Perm &x) { return invert(x); });
+    add(move(p), 0, 0);
+    extend_from(0, 0);
+  }
+
+  void extend_orbit() { extend_from(0, 0); }
+  void extend_orbit(const Perm &newgen) {
+    if (find(gens_.begin(), gens_.end(), newgen) == gens_.end()) {
+      gens_.push_back(newgen);
+      invgens_.push_back(invert(newgen));
+      extend_from(points_.size(), gens_.size() - 1);
+    }
+  }
+  auto begin() const { return points_.cbegin(); }
+  auto end() const { return points_.cend(); }
+  bool contains(const Point &p) const { return position(p) != npos; }
+  auto size() const { return points_.size(); }
+  const Point &root() const { return points_.front(); }
+
+  // true if points are looked up by rank, not by hash
+  bool rank_table() const { return use_table_; }
+
+  // image of p under g by orbit action
+  Point image(const Point &p, const Perm &g) const { return act_(p, g); }
+
+  // throw out_of_range if p is not in orbit
+  Perm ubeta(const Point &p) const;
+  word_t uword(const Point &p) const;
+  Point trace(Point p, const word_t &w) const {
+    for (auto k : w)
+      p = act_(p, gens_[k]);
+    return p;
+  }
+  void sift(Perm &h, const Point &p) const;
+  ostream &dump(ostream &os) const;
+
+private:
+  uint32_t position(const Point &p) const;
+  uint32_t checked_position(const Point &p) const;
+  void add(Point p, uint32_t label, uint32_t parent);
+  void extend_from(size_t oldsize, size_t firstgen);
+};
+
+template <typename T, typename Perm = Permutation<T>>
+using PairOrbit = ActionOrbit<pair<T, T>, Perm, OnPairs<T>>;
+
+template <typename T, typename Perm = Permutation<T>>
+using TupleOrbit = ActionOrbit<vector<T>, Perm, OnTuples<T>>;
+
+template <typename T, typename Perm = Permutation<T>>
+using SetOrbit = ActionOrbit<vector<T>, Perm, OnSets<T>>;
+
+//------------------------------------------------------------------------------
+//
+// implementation
+//
+//------------------------------------------------------------------------------
+
+template <typename Point, typename Perm, typename Action, typename Hash>
+uint32_t
+ActionOrbit<Point, Perm, Action, Hash>::position(const Point &p) const {
+  if constexpr (ranked) {
+    if (use_table_) {
+      size_t r = act_.rank(p);
+      return (r < table_.size()) ? table_[r] : npos;
+    }
+  }
+  auto it = index_.find(p);
+  return (it == index_.end()) ? npos : it->second;
+}
+
+template <typename Point, typename Perm, typename Action, typename Hash>
+uint32_t
+ActionOrbit<Point, Perm, Action, Hash>::checked_position(const Point &p) const {
+  auto pos = position(p);
+  if (pos == npos)
+    throw std::out_of_range("no such point in orbit");
+  return pos;
+}
+
+template <typename Point, typename Perm, typename Action, typename Hash>
+void ActionOrbit<Point, Perm, Action, Hash>::add(Point p, uint32_t label,
+                                                uint32_t parent) {
+  if (points_.size() == npos)
+    throw overflow_error("Orbit is too big");
+  uint32_t pos = points_.size();
+  if constexpr (ranked) {
+    if (use_table_)
+      table_[act_.rank(p)] = pos;
+    else
+      index_.emplace(p, pos);
+  } else {
+    index_.emplace(p, pos);
+  }
+  points_.push_back(move(p));
+  label_.push_back(label);
+  parent_.push_back(parent);
+}
+
+template <typename Point, typename Perm, typename Action, typename Hash>
+void ActionOrbit<Point, Perm, Action, Hash>::extend_from(size_t oldsize,
+                                                        size_t firstgen) {
+  for (size_t i = 0; i != points_.size(); ++i)
+    for (size_t g = (i < oldsize) ? firstgen : 0; g < gens_.size(); ++g)
+      if (auto newelem = act_(points_[i], gens_[g]); !contains(newelem))
+        add(move(newelem), g + 1, i);
+}
+
+template <typename Point, typename Perm, typename Action, typename Hash>
+Perm ActionOrbit<Point, Perm, Action, Hash>::ubeta(const Point &p) const {
+  Perm res{};
+  for (auto pos = checked_position(p); label_[pos] != 0; pos = parent_[pos])
+    res.lmul(gens_[label_[pos] - 1]);
+  return res;
+}
+
+template <typename Point, typename Perm, typename Action, typename Hash>
+word_t ActionOrbit<Point, Perm, Action, Hash>::uword(const Point &p) const {
+  word_t w;
+  for (auto pos = checked_position(p); label_[pos] != 0; pos = parent_[pos])
+    w.push_back(label_[pos] - 1);
+  reverse(w.begin(), w.end());
+  return w;
+}
+
+template <typename Point, typename Perm, typename Action, typename Hash>
+void ActionOrbit<Point, Perm, Action, Hash>::sift(Perm &h,
+                                                  const Point &p) const {
+  for (auto pos = checked_position(p); label_[pos] != 0; pos = parent_[pos])
+    h.rmul(invgens_[label_[pos] - 1]);
+}
+
+template <typename T> void dump_point(ostream &os, const T &x) { os << x; }
+
+template <typename T> void dump_point(ostream &os, const pair<T, T> &p) {
+  os << "(" << p.first << ", " << p.second << ")";
+}
+
+template <typename T> void dump_point(ostream &os, const vector<T> &p) {
+  os << "{";
+  for (size_t i = 0; i != p.size(); ++i)
+    os << (i ? ", " : "") << p[i];
+  os << "}";
+}
+
+template <typename Point, typename Perm, typename Action, typename Hash>
+ostream &ActionOrbit<Point, Perm, Action, Hash>::dump(ostream &os) const {
+  os << "[ ";
+  for (auto &&oit : points_) {
+    dump_point(os, oit);
+    os << ": " << ubeta(oit) << " ";
+  }
+  os << "]";
+  return os;
+}
+
+template <typename Point, typename Perm, typename Action, typename Hash>
+ostream &operator<<(ostream &os,
+                    const ActionOrbit<Point, Perm, Action, Hash> &d) {
+  return d.dump(os);
+}
+
+} // namespace orbits
+
+#endif
@@ -0,0 +1,555 @@
+//------------------------------------------------------------------------------
+//
+//  Backtrack search for subgroups
+//
+//------------------------------------------------------------------------------
+//
+// Given BSGS (B, S, Delta*) of G, every g in G is g = h * u[j-1] * ... * u[0]
+// with h in G[j] and u[i] transversal elements, so base images
+// b[i]^g = (b[i])^(u[i] * ... * u[0]) are fixed by choosing orbit points
+// level by level. Backtrack walks this tree depth first, node on level j is
+// c = u[j-1] * ... * u[0], all elements below it are h * c, h in G[j].
+//
+// Subgroup K = {g in G : prop(g)} is found bottom up (Butler's scheme):
+// for i = k-1 .. 0 only one element per K[i]-orbit of Delta[i] is searched,
+// since if g maps b[i] to x, then g * t maps b[i] to x^t for t in K[i]. Found
+// elements are strong generators of K relative to B.
+//
+// Nodes are pruned by prune(j, c), which shall return false only if no
+// element below c has property. For colorings (and sets, as two colors)
+// pruning is orbit/color-count check: h * c maps every orbit O of G[j] to
+// O^c, so every orbit shall keep its multiset of colors. Multisets are
+// compared by sums of color hashes, equal multisets always give equal sums,
+// so pruning is never wrong, and it is O(n) per node. It is weaker than
+// ordered partition refinement: cells are fixed per level, they are not
+// split by images of fixed points and nothing is propagated through
+// generators to equitable partition.
+//
+// Conjugacy x^-1 * g * x = h means x maps every cycle of g onto cycle of h
+// of the same length, point g^k(b) goes to h^k(b^x). So once image of one
+// base point is chosen, images of all base points on its cycle are forced.
+// Base is taken cycle by cycle, cycles of rare lengths first, and nodes are
+// pruned by fixed base points in O(k). Centralizer is the case h = g.
+// Normalizer of H permutes H-orbits, so it is pruned the same way by orbit
+// partition, it is meant for small H.
+//
+//------------------------------------------------------------------------------
+
+#ifndef BACKTRACK_GUARD_
+#define BACKTRACK_GUARD_
+
+#include <functional>
+#include <tuple>
+
+#include "groups.hpp"
+
+namespace groups {
+
+// strong generators of K = {g in G : prop(g)} relative to B, prop shall
+// define subgroup, prune(j, c) as above
+template <typename T, typename PermT, typename OrbT, typename Prop,
+          typename Prune>
+vector<PermT> subgroup_search_gens(const vector<T> &B,
+                                   vector<OrbT> &DeltaStar, Prop prop,
+                                   Prune prune);
+
+// same, but returns (B, S, Delta*) for K, without trivial levels, so
+// B is empty if K is trivial
+template <template <class...> class OrbT, typename T, typename PermT,
+          typename Prop, typename Prune>
+std::tuple<vector<T>, vector<vector<PermT>>, vector<OrbT<T, PermT>>>
+subgroup_search(const vector<T> &B, vector<OrbT<T, PermT>> &DeltaStar,
+                Prop prop, Prune prune);
+
+// removes levels with trivial basic orbits from (B, S, Delta*)
+template <typename T, typename PermT, typename OrbT>
+void drop_trivial_levels(vector<T> &B, vector<vector<PermT>> &S,
+                         vector<OrbT> &DeltaStar);
+
+// stabilizer of coloring in G = <gens>, col[x - T::start] is color of x
+// returns (B, S, Delta*) for it
+template <template <class...> class OrbT, typename RandIt>
+auto coloring_stabilizer(RandIt gensbeg, RandIt gensend,
+                         const vector<size_t> &col);
+
+// setwise stabilizer of points from [setbeg, setend) in G = <gens>
+template <template <class...> class OrbT, typename RandIt, typename SetIt>
+auto setwise_stabilizer(RandIt gensbeg, RandIt gensend, SetIt setbeg,
+                        SetIt setend);
+
+// element of G with prop, nullopt if there is none, prune(j, c) as above
+template <typename T, typename PermT, typename OrbT, typename Prop,
+          typename Prune>
+optional<PermT> element_search(const vector<T> &B, vector<OrbT> &DeltaStar,
+                               Prop prop, Prune prune);
+
+// centralizer of g in G = <gens>, g may be outside of G
+// returns (B, S, Delta*) for it
+template <template <class...> class OrbT, typename RandIt, typename PermT>
+auto centralizer(RandIt gensbeg, RandIt gensend, const PermT &g);
+
+// x in G = <gens> with x^-1 * g * x = h, nullopt if g and h are not
+// conjugate in G
+template <template <class...> class OrbT, typename RandIt, typename PermT>
+optional<PermT> is_conjugate(RandIt gensbeg, RandIt gensend, const PermT &g,
+                             const PermT &h);
+
+// normalizer of H = <hgens> in G = <gens>, returns (B, S, Delta*) for it
+template <template <class...> class OrbT, typename RandIt, typename HRandIt>
+auto normalizer(RandIt gensbeg, RandIt gensend, HRandIt hgensbeg,
+                HRandIt hgensend);
+
+//------------------------------------------------------------------------------
+//
+// implementation
+//
+//------------------------------------------------------------------------------
+
+template <typename T, typename PermT, typename OrbT, typename Prop,
+          typename Prune>
+class SubgroupSearch {
+  const vector<T> &B_;
+  vector<OrbT> &DeltaStar_;
+  Prop prop_;
+  Prune prune_;
+  vector<vector<T>> points_;
+  vector<PermT> kgens_;
+
+public:
+  SubgroupSearch(const vector<T> &B, vector<OrbT> &DeltaStar, Prop prop,
+                 Prune prune)
+      : B_(B), DeltaStar_(DeltaStar), prop_(prop), prune_(prune),
+        points_(B.size()) {
+    for (size_t i = 0; i != B.size(); ++i)
+      for (auto &&x : DeltaStar[i])
+        points_[i].push_back(x);
+  }
+
+  vector<PermT> run();
+
+  // any element with property
+  optional<PermT> first() { return search(0, PermT{}); }
+
+private:
+  // element with property below node c on level j
+  optional<PermT> search(size_t j, const PermT &c);
+
+  // marks orbit of x under found generators
+  void cover(T x, vector<char> &covered) const;
+};
+
+template <typename T, typename PermT, typename OrbT, typename Prop,
+          typename Prune>
+vector<PermT> SubgroupSearch<T, PermT, OrbT, Prop, Prune>::run() {
+  for (size_t i = B_.size(); i-- > 0;) {
+    vector<char> covered(T::fin - T::start + 1, 0);
+    cover(B_[i], covered);
+    for (auto &&x : points_[i]) {
+      if (covered[x - T::start])
+        continue;
+      auto c = DeltaStar_[i].ubeta(x);
+      optional<PermT> g;
+      if (prune_(i + 1, c))
+        g = search(i + 1, c);
+      if (g)
+        kgens_.push_back(*g);
+      cover(x, covered);
+    }
+  }
+  return kgens_;
+}
+
+template <typename T, typename PermT, typename OrbT, typename Prop,
+          typename Prune>
+optional<PermT> SubgroupSearch<T, PermT, OrbT, Prop, Prune>::search(
+    size_t j, const PermT &c) {
+  if (j == B_.size()) {
+    if (prop_(c))
+      return c;
+    return nullopt;
+  }
+
+  for (auto &&x : points_[j]) {
+    auto nc = product(DeltaStar_[j].ubeta(x), c);
+    if (!prune_(j + 1, nc))
+      continue;
+    if (auto g = search(j + 1, nc))
+      return g;
+  }
+  return nullopt;
+}
+
+template <typename T, typename PermT, typename OrbT, typename Prop,
+          typename Prune>
+void SubgroupSearch<T, PermT, OrbT, Prop, Prune>::cover(
+    T x, vector<char> &covered) const {
+  if (covered[x - T::start])
+    return;
+  vector<T> pts{x};
+  covered[x - T::start] = 1;
+  for (size_t p = 0; p != pts.size(); ++p)
+    for (auto &&k : kgens_)
+      if (auto y = k.apply(pts[p]); !covered[y - T::start]) {
+        covered[y - T::start] = 1;
+        pts.push_back(y);
+      }
+}
+
+template <typename T, typename PermT, typename OrbT, typename Prop,
+          typename Prune>
+vector<PermT> subgroup_search_gens(const vector<T> &B,
+                                   vector<OrbT> &DeltaStar, Prop prop,
+                                   Prune prune) {
+  SubgroupSearch<T, PermT, OrbT, Prop, Prune> ss(B, DeltaStar, prop, prune);
+  return ss.run();
+}
+
+template <typename T, typename PermT, typename OrbT, typename Prop,
+          typename Prune>
+optional<PermT> element_search(const vector<T> &B, vector<OrbT> &DeltaStar,
+                               Prop prop, Prune prune) {
+  SubgroupSearch<T, PermT, OrbT, Prop, Prune> ss(B, DeltaStar, prop, prune);
+  return ss.first();
+}
+
+template <typename T, typename PermT, typename OrbT>
+void drop_trivial_levels(vector<T> &B, vector<vector<PermT>> &S,
+                         vector<OrbT> &DeltaStar) {
+  for (size_t l = B.size(); l-- > 0;)
+    if (DeltaStar[l].size() == 1) {
+      B.erase(B.begin() + l);
+      S.erase(S.begin() + l);
+      DeltaStar.erase(DeltaStar.begin() + l);
+    }
+}
+
+template <template <class...> class OrbT, typename T, typename PermT,
+          typename Prop, typename Prune>
+std::tuple<vector<T>, vector<vector<PermT>>, vector<OrbT<T, PermT>>>
+subgroup_search(const vector<T> &B, vector<OrbT<T, PermT>> &DeltaStar,
+                Prop prop, Prune prune) {
+  auto kgens = subgroup_search_gens<T, PermT>(B, DeltaStar, prop, prune);
+  if (kgens.empty())
+    return {};
+  auto res = shreier_sims<OrbT>(kgens.begin(), kgens.end(), B.begin(),
+                                B.end());
+  auto & [ KB, KS, KDelta ] = res;
+  drop_trivial_levels(KB, KS, KDelta);
+  return res;
+}
+
+// orbit numbers of points under G[j] for all levels, and for every level
+// and orbit sum of color hashes of its points
+template <typename T, typename PermT> class ColorCountPruner {
+  size_t n_;
+  const vector<size_t> &col_;
+  vector<vector<uint32_t>> orbnum_;
+  vector<vector<uint64_t>> sums_;
+  vector<T> B_;
+
+  static constexpr uint32_t npos = static_cast<uint32_t>(-1);
+
+public:
+  ColorCountPruner(const vector<T> &B, const vector<vector<PermT>> &S,
+                   const vector<size_t> &col);
+
+  // node c on level j may have element, preserving colors, below it
+  bool operator()(size_t j, const PermT &c) const;
+
+private:
+  static uint64_t chash(size_t color) { return mix_hash(color); }
+};
+
+template <typename T, typename PermT>
+ColorCountPruner<T, PermT>::ColorCountPruner(const vector<T> &B,
+                                             const vector<vector<PermT>> &S,
+                                             const vector<size_t> &col)
+    : n_(T::fin - T::start + 1), col_(col), orbnum_(B.size() + 1),
+      sums_(B.size() + 1), B_(B) {
+  static const vector<PermT> nogens;
+  for (size_t j = 0; j <= B.size(); ++j) {
+    const auto &gens = (j < B.size()) ? S[j] : nogens;
+    auto &num = orbnum_[j];
+    num.assign(n_, npos);
+    uint32_t norb = 0;
+    for (size_t x0 = 0; x0 != n_; ++x0) {
+      if (num[x0] != npos)
+        continue;
+      vector<size_t> pts{x0};
+      num[x0] = norb;
+      for (size_t p = 0; p != pts.size(); ++p)
+        for (auto &&g : gens) {
+          size_t y = g.apply(static_cast<T>(T::start + pts[p])) - T::start;
+          if (num[y] == npos) {
+            num[y] = norb;
+            pts.push_back(y);
+          }
+        }
+      norb += 1;
+    }
+    sums_[j].assign(norb, 0);
+    for (size_t x = 0; x != n_; ++x)
+      sums_[j][num[x]] += chash(col_[x]);
+  }
+}
+
+template <typename T, typename PermT>
+bool ColorCountPruner<T, PermT>::operator()(size_t j, const PermT &c) const {
+  // last fixed base point keeps its color
+  T b = B_[j - 1];
+  if (col_[c.apply(b) - T::start] != col_[b - T::start])
+    return false;
+
+  const auto &num = orbnum_[j];
+  vector<uint64_t> sums(sums_[j].size(), 0);
+  for (size_t x = 0; x != n_; ++x)
+    sums[num[x]] += chash(col_[c.apply(static_cast<T>(T::start + x)) -
+                               T::start]);
+  return sums == sums_[j];
+}
+
+template <template <class...> class OrbT, typename RandIt>
+auto coloring_stabilizer(RandIt gensbeg, RandIt gensend,
+                         const vector<size_t> &col) {
+  using PermT = typename std::iterator_traits<RandIt>::value_type;
+  using T = typename PermT::value_type;
+  size_t n = T::fin - T::start + 1;
+  if (col.size() != n)
+    throw invalid_argument("Coloring shall give color for every point");
+
+  // points of small color classes go first into base, they prune most
+  map<size_t, size_t> clsize;
+  for (auto c : col)
+    clsize[c] += 1;
+  vector<T> pts(n);
+  iota(pts.begin(), pts.end(), T::start);
+  std::stable_sort(pts.begin(), pts.end(), [&](T x, T y) {
+    size_t cx = col[x - T::start], cy = col[y - T::start];
+    return make_pair(clsize[cx], cx) < make_pair(clsize[cy], cy);
+  });
+
+  auto[B, S, DeltaStar] =
+      shreier_sims<OrbT>(gensbeg, gensend, pts.begin(), pts.end());
+  drop_trivial_levels(B, S, DeltaStar);
+
+  ColorCountPruner<T, PermT> pruner(B, S, col);
+  auto prop = [&col, n](const PermT &g) {
+    for (size_t x = 0; x != n; ++x)
+      if (col[g.apply(static_cast<T>(T::start + x)) - T::start] != col[x])
+        return false;
+    return true;
+  };
+  return subgroup_search(B, DeltaStar, prop, std::cref(pruner));
+}
+
+template <template <class...> class OrbT, typename RandIt, typename SetIt>
+auto setwise_stabilizer(RandIt gensbeg, RandIt gensend, SetIt setbeg,
+                        SetIt setend) {
+  using PermT = typename std::iterator_traits<RandIt>::value_type;
+  using T = typename PermT::value_type;
+  vector<size_t> col(T::fin - T::start + 1, 0);
+  for (auto sit = setbeg; sit != setend; ++sit)
+    col[*sit - T::start] = 1;
+  return coloring_stabilizer<OrbT>(gensbeg, gensend, col);
+}
+
+// cycle of every point: number, position in it, and points of cycles
+template <typename T> struct CycleIndex {
+  vector<vector<T>> cycles;
+  vector<uint32_t> num, pos;
+
+  template <typename PermT> explicit CycleIndex(const PermT &p) {
+    size_t n = T::fin - T::start + 1;
+    num.assign(n, 0);
+    pos.assign(n, 0);
+    vector<bool> marked(n, false);
+    for (size_t x = 0; x != n; ++x) {
+      if (marked[x])
+        continue;
+      vector<T> c;
+      for (T y = static_cast<T>(T::start + x); !marked[y - T::start];
+           y = p.apply(y)) {
+        marked[y - T::start] = true;
+        num[y - T::start] = cycles.size();
+        pos[y - T::start] = c.size();
+        c.push_back(y);
+      }
+      cycles.push_back(move(c));
+    }
+  }
+
+  size_t length(T x) const { return cycles[num[x - T::start]].size(); }
+
+  // points cycle by cycle, cycles of rare lengths first
+  vector<T> base() const {
+    map<size_t, size_t> npts;
+    for (auto &&c : cycles)
+      npts[c.size()] += c.size();
+    vector<size_t> order(cycles.size());
+    iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      size_t la = cycles[a].size(), lb = cycles[b].size();
+      return make_pair(npts[la], la) < make_pair(npts[lb], lb);
+    });
+    vector<T> res;
+    for (auto o : order)
+      res.insert(res.end(), cycles[o].begin(), cycles[o].end());
+    return res;
+  }
+};
+
+// node c may have x below it with g^k(b) -> h^k(b^x) for base points
+template <typename T, typename PermT> class CycleMapPruner {
+  vector<T> B_;
+  CycleIndex<T> g_, h_;
+
+public:
+  CycleMapPruner(const vector<T> &B, const PermT &g, const PermT &h)
+      : B_(B), g_(g), h_(h) {}
+
+  bool operator()(size_t j, const PermT &c) const;
+};
+
+template <typename T, typename PermT>
+bool CycleMapPruner<T, PermT>::operator()(size_t j, const PermT &c) const {
+  T b = B_[j - 1], y = c.apply(b);
+  size_t len = g_.length(b);
+  if (h_.length(y) != len)
+    return false;
+
+  size_t gb = g_.num[b - T::start], hy = h_.num[y - T::start];
+  for (size_t m = 0; m + 1 < j; ++m) {
+    T bm = B_[m], ym = c.apply(bm);
+    if (g_.num[bm - T::start] != gb) {
+      // other cycle shall go to other cycle
+      if (h_.num[ym - T::start] == hy)
+        return false;
+      continue;
+    }
+    size_t k = (g_.pos[bm - T::start] + len - g_.pos[b - T::start]) % len;
+    if (h_.cycles[hy][(h_.pos[y - T::start] + k) % len] != ym)
+      return false;
+  }
+  return true;
+}
+
+// node c may have x below it, mapping H-orbits of base points to H-orbits
+template <typename T, typename PermT> class OrbitMapPruner {
+  vector<T> B_;
+  vector<uint32_t> num_, size_;
+
+public:
+  OrbitMapPruner(const vector<T> &B, vector<uint32_t> num,
+                 vector<uint32_t> size)
+      : B_(B), num_(move(num)), size_(move(size)) {}
+
+  bool operator()(size_t j, const PermT &c) const {
+    T b = B_[j - 1], y = c.apply(b);
+    if (size_[num_[b - T::start]] != size_[num_[y - T::start]])
+      return false;
+    for (size_t m = 0; m + 1 < j; ++m) {
+      T bm = B_[m], ym = c.apply(bm);
+      bool same = (num_[bm - T::start] == num_[b - T::start]);
+      if (same != (num_[ym - T::start] == num_[y - T::start]))
+        return false;
+    }
+    return true;
+  }
+};
+
+template <template <class...> class OrbT, typename RandIt, typename PermT>
+auto centralizer(RandIt gensbeg, RandIt gensend, const PermT &g) {
+  using T = typename PermT::value_type;
+  auto pts = CycleIndex<T>(g).base();
+  auto[B, S, DeltaStar] =
+      shreier_sims<OrbT>(gensbeg, gensend, pts.begin(), pts.end());
+  drop_trivial_levels(B, S, DeltaStar);
+
+  CycleMapPruner<T, PermT> pruner(B, g, g);
+  auto prop = [&g](const PermT &x) { return product(g, x) == product(x, g); };
+  return subgroup_search(B, DeltaStar, prop, std::cref(pruner));
+}
+
+template <template <class...> class OrbT, typename RandIt, typename PermT>
+optional<PermT> is_conjugate(RandIt gensbeg, RandIt gensend, const PermT &g,
+                             const PermT &h) {
+  using T = typename PermT::value_type;
+  if (cycle_type(g) != cycle_type(h))
+    return nullopt;
+
+  auto pts = CycleIndex<T>(g).base();
+  auto[B, S, DeltaStar] =
+      shreier_sims<OrbT>(gensbeg, gensend, pts.begin(), pts.end());
+  drop_trivial_levels(B, S, DeltaStar);
+
+  CycleMapPruner<T, PermT> pruner(B, g, h);
+  auto prop = [&g, &h](const PermT &x) {
+    return product(g, x) == product(x, h);
+  };
+  return element_search<T, PermT>(B, DeltaStar, prop, std::cref(pruner));
+}
+
+template <template <class...> class OrbT, typename RandIt, typename HRandIt>
+auto normalizer(RandIt gensbeg, RandIt gensend, HRandIt hgensbeg,
+                HRandIt hgensend) {
+  using PermT = typename std::iterator_traits<RandIt>::value_type;
+  using T = typename PermT::value_type;
+  size_t n = T::fin - T::start + 1;
+  vector<PermT> hgens;
+  for (auto hit = hgensbeg; hit != hgensend; ++hit)
+    if (*hit != hit->id())
+      hgens.push_back(*hit);
+
+  // H-orbits, numbered by smallest point
+  constexpr uint32_t npos = static_cast<uint32_t>(-1);
+  vector<uint32_t> num(n, npos), size;
+  for (size_t x0 = 0; x0 != n; ++x0) {
+    if (num[x0] != npos)
+      continue;
+    vector<T> orb{static_cast<T>(T::start + x0)};
+    num[x0] = size.size();
+    for (size_t p = 0; p != orb.size(); ++p)
+      for (auto &&s : hgens)
+        if (auto y = s.apply(orb[p]); num[y - T::start] == npos) {
+          num[y - T::start] = size.size();
+          orb.push_back(y);
+        }
+    size.push_back(orb.size());
+  }
+
+  // small orbits first, orbit by orbit
+  vector<T> pts(n);
+  iota(pts.begin(), pts.end(), T::start);
+  std::stable_sort(pts.begin(), pts.end(), [&](T x, T y) {
+    uint32_t ox = num[x - T::start], oy = num[y - T::start];
+    return make_pair(size[ox], ox) < make_pair(size[oy], oy);
+  });
+
+  auto[B, S, DeltaStar] =
+      shreier_sims<OrbT>(gensbeg, gensend, pts.begin(), pts.end());
+  drop_trivial_levels(B, S, DeltaStar);
+
+  // H itself for membership tests of conjugated generators
+  vector<T> hpts{T::start};
+  auto hchain =
+      shreier_sims<OrbT>(hgens.begin(), hgens.end(), hpts.begin(), hpts.end());
+  auto &HB = std::get<0>(hchain);
+  auto &HDelta = std::get<2>(hchain);
+  auto prop = [&](const PermT &x) {
+    auto xinv = invert(x);
+    for (auto &&s : hgens) {
+      auto res = strip(product(product(xinv, s), x), HB.begin(), HB.end(),
+                       HDelta.begin());
+      if (res.second != HB.end() || res.first != res.first.id())
+        return false;
+    }
+    return true;
+  };
+
+  OrbitMapPruner<T, PermT> pruner(B, move(num), move(size));
+  return subgroup_search(B, DeltaStar, prop, std::cref(pruner));
+}
+
+} // namespace groups
+
+#endif
@@ -0,0 +1,253 @@
+//------------------------------------------------------------------------------
+//
+//  Walking group given by base and strong generating set
+//
+//------------------------------------------------------------------------------
+//
+// Given (B, S, Delta*) from shreier_sims, every group element is uniquely
+//
+//   g = u[k-1] * ... * u[1] * u[0]
+//
+// where u[i] is transversal element of Delta[i], i.e. ubeta of some point of
+// i-th basic orbit. So elements may be enumerated like odometer over orbit
+// points without storing any of them.
+//
+// ElementStream keeps current points and prefix products
+// p[j] = u[k-1] * ... * u[j], so moving to next element costs one product
+// for every level which changed its point. First level changes on every step,
+// so its transversal is calculated once, others are calculated on demand.
+//
+// Memory is O((k + |Delta[0]|) * n): prefixes plus first level transversal,
+// so at most O(n^2), independent of group order
+//
+// Same decomposition gives mixed radix numbering of elements: if idx[i] is
+// number of u[i] point in i-th orbit, then
+//
+//   rank(g) = idx[0] + |Delta[0]| * (idx[1] + |Delta[1]| * (idx[2] + ...))
+//
+// is in [0, |G|) and ElementStream visits elements exactly in rank order.
+// ElementRank finds idx[i] by stripping g, and unrank goes backwards
+//
+//------------------------------------------------------------------------------
+
+#ifndef BSGS_GUARD_
+#define BSGS_GUARD_
+
+#include <type_traits>
+
+#include "groups.hpp"
+
+namespace groups {
+
+template <typename DeltaIt> class ElementStream {
+  using OrbT = typename std::iterator_traits<DeltaIt>::value_type;
+  using T = typename OrbT::type;
+  using PermT =
+      std::decay_t<decltype(std::declval<OrbT &>().ubeta(std::declval<T>()))>;
+
+  DeltaIt dstart_;
+  size_t nlevels_;
+  vector<vector<T>> points_;
+  vector<size_t> idx_;
+
+  // prefix_[j] = u[k-1] * ... * u[j] for current points, prefix_[k] = id
+  vector<PermT> prefix_;
+
+  // transversal of first level, O(|Delta[0]| * n)
+  vector<PermT> first_;
+
+  PermT cur_;
+  bool done_ = false;
+
+public:
+  using value_type = PermT;
+
+  // ctors/dtors
+public:
+  // orbits are not copied, they shall outlive stream
+  ElementStream(DeltaIt dstart, DeltaIt dfin);
+
+  // modifiers
+public:
+  // advance to next element, or to done state after last one
+  ElementStream &operator++();
+
+  // selectors
+public:
+  bool done() const { return done_; }
+  const PermT &operator*() const { return cur_; }
+  const PermT *operator->() const { return &cur_; }
+
+  // service functions
+private:
+  // recalculate prefixes from level top (inclusive) down and current element
+  void recalc(size_t top);
+};
+
+// rank and unrank of group elements, group order shall fit in 64 bits
+template <typename BaseIt, typename DeltaIt> class ElementRank {
+  using OrbT = typename std::iterator_traits<DeltaIt>::value_type;
+  using T = typename OrbT::type;
+  using PermT =
+      std::decay_t<decltype(std::declval<OrbT &>().ubeta(std::declval<T>()))>;
+
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  BaseIt bstart_;
+  DeltaIt dstart_;
+  size_t nlevels_;
+  vector<vector<T>> points_;
+
+  // number_[i][x - T::start] is number of point x in i-th orbit or npos
+  vector<vector<size_t>> number_;
+  uint64_t order_ = 1;
+
+public:
+  // orbits are not copied, they shall outlive ranker
+  // throws overflow_error if group order do not fit in 64 bits
+  ElementRank(BaseIt bstart, BaseIt bfin, DeltaIt dstart);
+
+  // group order
+  uint64_t order() const { return order_; }
+
+  // rank of g, nullopt if g is not in group
+  optional<uint64_t> rank(const PermT &g) const;
+
+  // element of given rank, throws invalid_argument if r >= order()
+  PermT unrank(uint64_t r) const;
+};
+
+// calls visitor(g) for every group element g, given by Delta*
+// visitor may return bool, then false stops enumeration
+// returns number of visited elements
+template <typename DeltaIt, typename F>
+size_t for_each_element(DeltaIt dstart, DeltaIt dfin, F visitor);
+
+//------------------------------------------------------------------------------
+//
+// implementation
+//
+//------------------------------------------------------------------------------
+
+template <typename DeltaIt>
+ElementStream<DeltaIt>::ElementStream(DeltaIt dstart, DeltaIt dfin)
+    : dstart_(dstart), nlevels_(distance(dstart, dfin)), points_(nlevels_),
+      idx_(nlevels_, 0), prefix_(nlevels_ + 1) {
+  for (size_t i = 0; i != nlevels_; ++i)
+    for (auto &&beta : dstart_[i])
+      points_[i].push_back(beta);
+
+  if (nlevels_ == 0)
+    return;
+
+  for (auto &&beta : points_[0])
+    first_.push_back(dstart_[0].ubeta(beta));
+  recalc(nlevels_ - 1);
+}
+
+template <typename DeltaIt>
+ElementStream<DeltaIt> &ElementStream<DeltaIt>::operator++() {
+  assert(!done_);
+  if (nlevels_ == 0) {
+    done_ = true;
+    return *this;
+  }
+
+  // first level does not need prefix recalculation
+  if (++idx_[0] != points_[0].size()) {
+    cur_ = product(prefix_[1], first_[idx_[0]]);
+    return *this;
+  }
+
+  size_t lvl = 0;
+  while (lvl != nlevels_ && idx_[lvl] == points_[lvl].size()) {
+    idx_[lvl] = 0;
+    if (++lvl != nlevels_)
+      ++idx_[lvl];
+  }
+
+  if (lvl == nlevels_) {
+    done_ = true;
+    return *this;
+  }
+
+  recalc(lvl);
+  return *this;
+}
+
+template <typename DeltaIt> void ElementStream<DeltaIt>::recalc(size_t top) {
+  for (size_t j = top + 1; j-- > 1;)
+    prefix_[j] =
+        product(prefix_[j + 1], dstart_[j].ubeta(points_[j][idx_[j]]));
+  cur_ = product(prefix_[1], first_[idx_[0]]);
+}
+
+template <typename DeltaIt, typename F>
+size_t for_each_element(DeltaIt dstart, DeltaIt dfin, F visitor) {
+  size_t count = 0;
+  for (ElementStream<DeltaIt> s(dstart, dfin); !s.done(); ++s) {
+    count += 1;
+    if constexpr (std::is_same_v<decltype(visitor(*s)), bool>) {
+      if (!visitor(*s))
+        break;
+    } else {
+      visitor(*s);
+    }
+  }
+  return count;
+}
+
+template <typename BaseIt, typename DeltaIt>
+ElementRank<BaseIt, DeltaIt>::ElementRank(BaseIt bstart, BaseIt bfin,
+                                          DeltaIt dstart)
+    : bstart_(bstart), dstart_(dstart), nlevels_(distance(bstart, bfin)),
+      points_(nlevels_), number_(nlevels_) {
+  for (size_t i = 0; i != nlevels_; ++i) {
+    number_[i].assign(T::fin - T::start + 1, npos);
+    for (auto &&beta : dstart_[i]) {
+      number_[i][beta - T::start] = points_[i].size();
+      points_[i].push_back(beta);
+    }
+    uint64_t sz = points_[i].size();
+    if (order_ > std::numeric_limits<uint64_t>::max() / sz)
+      throw overflow_error("Group order do not fit in 64 bits");
+    order_ *= sz;
+  }
+}
+
+template <typename BaseIt, typename DeltaIt>
+auto ElementRank<BaseIt, DeltaIt>::rank(const PermT &g) const
+    -> optional<uint64_t> {
+  // same as strip, but remembers numbers of orbit points
+  PermT h = g;
+  uint64_t r = 0, radix = 1;
+  for (size_t i = 0; i != nlevels_; ++i) {
+    auto beta = h.apply(bstart_[i]);
+    size_t num = number_[i][beta - T::start];
+    if (num == npos)
+      return nullopt;
+    r += num * radix;
+    radix *= points_[i].size();
+    h.rmul(invert(dstart_[i].ubeta(beta)));
+  }
+  if (h != h.id())
+    return nullopt;
+  return r;
+}
+
+template <typename BaseIt, typename DeltaIt>
+auto ElementRank<BaseIt, DeltaIt>::unrank(uint64_t r) const -> PermT {
+  if (r >= order_)
+    throw invalid_argument("Rank is out of group order");
+  PermT g{};
+  for (size_t i = 0; i != nlevels_; ++i) {
+    size_t sz = points_[i].size();
+    g.lmul(dstart_[i].ubeta(points_[i][r % sz]));
+    r /= sz;
+  }
+  return g;
+}
+
+} // namespace groups
+
+#endif
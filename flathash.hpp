@@ -0,0 +1,315 @@
+//------------------------------------------------------------------------------
+//
+//  Flat hash containers
+//
+//------------------------------------------------------------------------------
+//
+// FlatSet<K> and FlatMap<K, V> are open-addressing hash containers, tuned for
+// keys which are expensive to compare and to move, like permutations.
+//
+// Entries are stored contiguously in insertion order. Separate power-of-two
+// index table with linear probing keeps entry number along with 32 bits of
+// hash, so probing almost never touches entries, and rehashing never moves
+// them. Iteration walks entries in insertion order.
+//
+// Erase is not supported: group algorithms only ever grow their sets.
+//
+//------------------------------------------------------------------------------
+
+#ifndef FLATHASH_GUARD_
+#define FLATHASH_GUARD_
+
+#include <functional>
+
+#include "permcommon.hpp"
+
+namespace permutations {
+
+//------------------------------------------------------------------------------
+//
+// Index table, shared by set and map
+//
+//------------------------------------------------------------------------------
+
+class FlatIndex {
+  struct Slot {
+    uint32_t idx; // entry number + 1, 0 means empty slot
+    uint32_t tag; // upper bits of hash
+  };
+
+  vector<Slot> slots_;
+  size_t mask_ = 0;
+
+public:
+  // find slot for key with given hash. eq(idx) checks entry idx
+  // returns pair (entry index or npos, slot position to insert into)
+  template <typename Eq> pair<size_t, size_t> lookup(size_t hash, Eq eq) const;
+
+  // occupy slot, found by lookup
+  void occupy(size_t pos, size_t hash, size_t idx) {
+    slots_[pos] = Slot{static_cast<uint32_t>(idx + 1), tag(hash)};
+  }
+
+  // true if table shall grow before inserting into container of size sz
+  bool need_grow(size_t sz) const { return (sz + 1) * 2 > slots_.size(); }
+
+  // rebuild table for at least sz entries, hashes are taken from hf(idx)
+  template <typename HashOf> void rebuild(size_t sz, size_t nentries, HashOf hf);
+
+  void clear() {
+    slots_.clear();
+    mask_ = 0;
+  }
+
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+private:
+  static uint32_t tag(size_t hash) {
+    return static_cast<uint32_t>(static_cast<uint64_t>(hash) >> 32);
+  }
+
+  // keys may come with weak hashes, like std::hash for integers
+  static size_t start(size_t hash) { return mix_hash(hash); }
+};
+
+template <typename Eq>
+pair<size_t, size_t> FlatIndex::lookup(size_t hash, Eq eq) const {
+  if (slots_.empty())
+    return make_pair(npos, npos);
+  uint32_t t = tag(hash);
+  for (size_t pos = start(hash) & mask_;; pos = (pos + 1) & mask_) {
+    const Slot &s = slots_[pos];
+    if (s.idx == 0)
+      return make_pair(npos, pos);
+    if ((s.tag == t) && eq(s.idx - 1))
+      return make_pair(static_cast<size_t>(s.idx - 1), pos);
+  }
+}
+
+template <typename HashOf>
+void FlatIndex::rebuild(size_t sz, size_t nentries, HashOf hf) {
+  size_t cap = 16;
+  while (cap < sz * 2)
+    cap *= 2;
+  if (cap <= slots_.size())
+    return;
+  slots_.assign(cap, Slot{0, 0});
+  mask_ = cap - 1;
+  for (size_t idx = 0; idx != nentries; ++idx) {
+    size_t h = hf(idx);
+    size_t pos = start(h) & mask_;
+    while (slots_[pos].idx != 0)
+      pos = (pos + 1) & mask_;
+    occupy(pos, h, idx);
+  }
+}
+
+//------------------------------------------------------------------------------
+//
+// Flat set
+//
+//------------------------------------------------------------------------------
+
+template <typename K, typename Hash = std::hash<K>,
+          typename Eq = std::equal_to<K>>
+class FlatSet {
+  vector<K> keys_;
+  vector<size_t> hashes_;
+  FlatIndex index_;
+  Hash hf_;
+  Eq eq_;
+
+public:
+  using value_type = K;
+  using iterator = typename vector<K>::const_iterator;
+  using const_iterator = iterator;
+
+  FlatSet() = default;
+
+  template <typename FwdIt> FlatSet(FwdIt b, FwdIt e) { insert(b, e); }
+
+  FlatSet(initializer_list<K> ilist) : FlatSet(ilist.begin(), ilist.end()) {}
+
+  // modifiers
+public:
+  // returns (position, true if inserted)
+  template <typename KK> pair<iterator, bool> insert(KK &&key);
+
+  template <typename FwdIt> void insert(FwdIt b, FwdIt e) {
+    for (auto it = b; it != e; ++it)
+      insert(*it);
+  }
+
+  void reserve(size_t sz) {
+    keys_.reserve(sz);
+    hashes_.reserve(sz);
+    index_.rebuild(sz, keys_.size(), [this](size_t i) { return hashes_[i]; });
+  }
+
+  void clear() {
+    keys_.clear();
+    hashes_.clear();
+    index_.clear();
+  }
+
+  void swap(FlatSet &rhs) {
+    keys_.swap(rhs.keys_);
+    hashes_.swap(rhs.hashes_);
+    std::swap(index_, rhs.index_);
+  }
+
+  // selectors
+public:
+  iterator find(const K &key) const {
+    size_t h = hf_(key);
+    auto found = index_.lookup(
+        h, [&](size_t i) { return hashes_[i] == h && eq_(keys_[i], key); });
+    if (found.first == FlatIndex::npos)
+      return keys_.end();
+    return keys_.begin() + found.first;
+  }
+
+  size_t count(const K &key) const { return (find(key) != end()) ? 1 : 0; }
+  bool contains(const K &key) const { return find(key) != end(); }
+  size_t size() const { return keys_.size(); }
+  bool empty() const { return keys_.empty(); }
+  iterator begin() const { return keys_.begin(); }
+  iterator end() const { return keys_.end(); }
+
+  // entries in insertion order
+  const vector<K> &keys() const { return keys_; }
+};
+
+template <typename K, typename Hash, typename Eq>
+template <typename KK>
+auto FlatSet<K, Hash, Eq>::insert(KK &&key) -> pair<iterator, bool> {
+  if (index_.need_grow(keys_.size()))
+    index_.rebuild(keys_.size() + 1, keys_.size(),
+                   [this](size_t i) { return hashes_[i]; });
+  size_t h = hf_(key);
+  auto found = index_.lookup(
+      h, [&](size_t i) { return hashes_[i] == h && eq_(keys_[i], key); });
+  if (found.first != FlatIndex::npos)
+    return make_pair(keys_.begin() + found.first, false);
+  index_.occupy(found.second, h, keys_.size());
+  keys_.emplace_back(forward<KK>(key));
+  hashes_.push_back(h);
+  return make_pair(prev(keys_.end()), true);
+}
+
+//------------------------------------------------------------------------------
+//
+// Flat map
+//
+//------------------------------------------------------------------------------
+
+template <typename K, typename V, typename Hash = std::hash<K>,
+          typename Eq = std::equal_to<K>>
+class FlatMap {
+  vector<pair<K, V>> entries_;
+  vector<size_t> hashes_;
+  FlatIndex index_;
+  Hash hf_;
+  Eq eq_;
+
+public:
+  using key_type = K;
+  using mapped_type = V;
+  using value_type = pair<K, V>;
+  using iterator = typename vector<pair<K, V>>::iterator;
+  using const_iterator = typename vector<pair<K, V>>::const_iterator;
+
+  // modifiers
+public:
+  // returns (position, true if inserted). Existing value is not replaced
+  template <typename KK, typename... Args>
+  pair<iterator, bool> emplace(KK &&key, Args &&... args);
+
+  pair<iterator, bool> insert(const value_type &kv) {
+    return emplace(kv.first, kv.second);
+  }
+
+  template <typename FwdIt> void insert(FwdIt b, FwdIt e) {
+    for (auto it = b; it != e; ++it)
+      insert(*it);
+  }
+
+  V &operator[](const K &key) { return emplace(key).first->second; }
+
+  void reserve(size_t sz) {
+    entries_.reserve(sz);
+    hashes_.reserve(sz);
+    index_.rebuild(sz, entries_.size(),
+                   [this](size_t i) { return hashes_[i]; });
+  }
+
+  void clear() {
+    entries_.clear();
+    hashes_.clear();
+    index_.clear();
+  }
+
+  // selectors
+public:
+  const_iterator find(const K &key) const {
+    size_t idx = lookup(key);
+    return (idx == FlatIndex::npos) ? entries_.end() : entries_.begin() + idx;
+  }
+
+  iterator find(const K &key) {
+    size_t idx = lookup(key);
+    return (idx == FlatIndex::npos) ? entries_.end() : entries_.begin() + idx;
+  }
+
+  const V &at(const K &key) const {
+    auto it = find(key);
+    if (it == end())
+      throw std::out_of_range("no such key in FlatMap");
+    return it->second;
+  }
+
+  size_t count(const K &key) const { return (lookup(key) != FlatIndex::npos); }
+  bool contains(const K &key) const { return count(key) != 0; }
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+
+private:
+  size_t lookup(const K &key) const {
+    size_t h = hf_(key);
+    return index_
+        .lookup(h,
+                [&](size_t i) {
+                  return hashes_[i] == h && eq_(entries_[i].first, key);
+                })
+        .first;
+  }
+};
+
+template <typename K, typename V, typename Hash, typename Eq>
+template <typename KK, typename... Args>
+auto FlatMap<K, V, Hash, Eq>::emplace(KK &&key, Args &&... args)
+    -> pair<iterator, bool> {
+  if (index_.need_grow(entries_.size()))
+    index_.rebuild(entries_.size() + 1, entries_.size(),
+                   [this](size_t i) { return hashes_[i]; });
+  size_t h = hf_(key);
+  auto found = index_.lookup(h, [&](size_t i) {
+    return hashes_[i] == h && eq_(entries_[i].first, key);
+  });
+  if (found.first != FlatIndex::npos)
+    return make_pair(entries_.begin() + found.first, false);
+  index_.occupy(found.second, h, entries_.size());
+  entries_.emplace_back(std::piecewise_construct,
+                        std::forward_as_tuple(forward<KK>(key)),
+                        std::forward_as_tuple(forward<Args>(args)...));
+  hashes_.push_back(h);
+  return make_pair(prev(entries_.end()), true);
+}
+
+} // namespace permutations
+
+#endif
@@ -21,28 +21,82 @@ template <typename T> using gensets_t = vector<gens_t<T>>;
 // primitivity blocks. Index in vector is #of class, vector of elements is class
 template <typename T> using classes_t = vector<vector<T>>;
 
-// random element via product replacement algorithm
+// random elements via product replacement algorithm
 // ref: HCGT page 71
 // ref: https://en.wikipedia.org/wiki/Nielsen_transformation
 // r is size of generators vector
 // n is amount of burn-in session
 // passing r < 2 means "pick automaticaly"
-// returns function, returning random group elements
+// all randomness comes from own engine, so same seed and stream give same
+// elements, and engines with different streams may run in parallel
+template <typename PermT> class ProductReplacement {
+  vector<PermT> x_;
+  PermT x0_;
+  Xoshiro256 rng_;
+
+public:
+  template <typename RandIt>
+  ProductReplacement(RandIt gensbeg, RandIt gensend, Xoshiro256 rng,
+                     size_t r = 0, size_t n = 10);
+
+  template <typename RandIt>
+  ProductReplacement(RandIt gensbeg, RandIt gensend, uint64_t seed,
+                     uint64_t stream = 0, size_t r = 0, size_t n = 10)
+      : ProductReplacement(gensbeg, gensend, Xoshiro256(seed, stream), r, n) {
+  }
+
+  // next random element
+  PermT operator()();
+
+  // next n random elements
+  template <typename OutIt> OutIt fill(size_t n, OutIt out) {
+    while (n-- > 0)
+      *out++ = (*this)();
+    return out;
+  }
+};
+
+// n random elements to out[0] .. out[n-1], made by nthreads threads
+// (0 means all hardware threads). Elements go in blocks of fixed size, k-th
+// block comes from stream k of seed, so result do not depend on nthreads
+template <typename RandIt, typename OutRandIt>
+void random_elements(RandIt gensbeg, RandIt gensend, size_t n, OutRandIt out,
+                     uint64_t seed, size_t nthreads = 0);
+
+// function, returning random group elements, seeded from random_device
 // x = random_init(gbeg, gend, 10); auto t1 = x(), t2 = x(), t3 = x();
 template <typename RandIt>
 auto random_init(RandIt gensbeg, RandIt gensend, size_t r = 0, size_t n = 10);
 
-// all elements from group
+// all elements from group, in BFS order from id
 // will likely explode in general case, but useful for small tests
 template <typename RandIt, typename OutIt>
 size_t all_elements(RandIt gensbeg, RandIt gensend, OutIt results);
 
+// same elements as all_elements, but each BFS level is expanded by nthreads
+// threads (0 means all hardware threads), order of output is unspecified
+template <typename RandIt, typename OutIt>
+size_t all_elements_parallel(RandIt gensbeg, RandIt gensend, OutIt results,
+                             size_t nthreads = 0);
+
 // ref: HCGT, page 84
 // primitive block system for given transitive group action
 // really returns classes_t<T>
+// class of num1 goes first, others by smallest element, elements ascending
 template <typename T, typename RandIt>
 auto primitive_blocks(T num1, T num2, RandIt gensbeg, RandIt gensend);
 
+// ref: HCGT, page 85
+// all block systems with minimal nontrivial blocks for given transitive group
+// action. Blocks of T::start with every other point are found by nthreads
+// threads (0 means all hardware threads), then systems whose block of
+// T::start contains smaller nontrivial block are dropped
+// returns vector<classes_t<T>>, ordered by second smallest point in block of
+// T::start, empty for primitive action
+template <typename RandIt>
+auto minimal_block_systems(RandIt gensbeg, RandIt gensend,
+                           size_t nthreads = 0);
+
 // ref: HCGT, page 89
 // takes generator g, sets Base and Delta* from shreier_sims below
 // returns h (possibly id). If h is not id, then g not in G.
@@ -57,140 +111,369 @@ auto strip(Perm g, BaseIt bstart, BaseIt bfin, DeltaIt dstart);
 // Define: Gi = Stab(G, b[1], .. b[i-1]), G1 = G, G2 fixes b1, etc...
 // S is strong generating set {S1 .. Sk} if Gi == <S[i]>
 // Delta* is set of orbits. Each Delta[i] is orbit of b[i] in G[i]
-template <template <class> class OrbT, typename RandIt>
+// Permutation type is taken from generators, so OrbT<T, Perm> is used
+template <template <class...> class OrbT, typename RandIt>
 auto shreier_sims(RandIt gensbeg, RandIt gensend);
 
+// same, but base starts with given points in given order (duplicates are
+// skipped), redundant points with trivial basic orbits are allowed.
+// Points moved by generators, which fix all given ones, are appended
+template <template <class...> class OrbT, typename RandIt, typename BaseIt>
+auto shreier_sims(RandIt gensbeg, RandIt gensend, BaseIt bbeg, BaseIt bend);
+
+// takes complete (B, S, Delta*) from shreier_sims and new generator g
+// if g is not in group, updates them to BSGS of <G, g> and returns true
+// otherwise leaves everything as is and returns false
+template <typename T, typename PermT, typename OrbT>
+bool shreier_sims_extend(vector<T> &B, vector<vector<PermT>> &S,
+                         vector<OrbT> &DeltaStar, const PermT &g);
+
+// ref: HCGT, page 103
+// swaps b[i] and b[i+1] in complete (B, S, Delta*), levels other than i and
+// i + 1 are not changed
+template <typename T, typename PermT, typename OrbT>
+void base_swap(size_t i, vector<T> &B, vector<vector<PermT>> &S,
+               vector<OrbT> &DeltaStar);
+
+// ref: HCGT, page 105
+// changes base of complete (B, S, Delta*) so it starts with given points,
+// moving them up by base swaps. Redundant levels after them are removed
+template <typename T, typename PermT, typename OrbT, typename BaseIt>
+void change_base(vector<T> &B, vector<vector<PermT>> &S,
+                 vector<OrbT> &DeltaStar, BaseIt nbeg, BaseIt nend);
+
+// replaces (B, S, Delta*) for G by one for G^c = c^-1 * G * c
+// with base B^c and generators s^c. Orbits are relabeled by their
+// conjugate(c), so it is O(n) per orbit point plus one conjugation per
+// generator, with no orbit calculation. Orbit types without conjugate are
+// rebuilt from scratch
+template <typename T, typename PermT, typename OrbT>
+void conjugate_chain(vector<T> &B, vector<vector<PermT>> &S,
+                     vector<OrbT> &DeltaStar, const PermT &c);
+
+// ref: HCGT, page 96
+// removes redundant strong generators from all levels of (B, S, Delta*),
+// bottom up. Each S[i] becomes S[i+1] plus those of old S[i], without which
+// orbit of b[i] gets smaller, and Delta[i] is rebuilt when S[i] changes
+// shreier_sims and random_shreier_sims call it themselves
+template <typename BaseIt, typename SetIt, typename DeltaIt>
+void remove_redundant_gens(BaseIt bstart, BaseIt bfin, SetIt sstart,
+                           DeltaIt dstart);
+
+// order of group, given by Delta* from shreier_sims, as product of basic
+// orbit sizes. Throws overflow_error if it does not fit in 64 bits
+template <typename DeltaIt> uint64_t group_order(DeltaIt dstart, DeltaIt dfin);
+
+// ref: HCGT, page 98
+// randomized version: strips random elements instead of all Schreier
+// generators, result has the same form as for shreier_sims
+// stops after nsucc consecutive random elements are stripped to id or as
+// soon as product of orbit sizes reaches known_order, if it is not 0 (then
+// result is surely complete). For uniformly random elements first stop
+// gives wrong result with probability at most 2^-nsucc, but product
+// replacement elements are not uniform, so this bound is only heuristic:
+// pass known_order or verify result when it matters
+// random elements come from ProductReplacement with given seed, or seeded
+// from random_device if there is no seed
+template <template <class...> class OrbT, typename RandIt>
+auto random_shreier_sims(RandIt gensbeg, RandIt gensend, size_t nsucc = 20,
+                         uint64_t known_order = 0,
+                         optional<uint64_t> seed = nullopt);
+
 //------------------------------------------------------------------------------
 //
 // implementation
 //
 //------------------------------------------------------------------------------
 
+template <typename PermT>
 template <typename RandIt>
-auto random_init(RandIt gensbeg, RandIt gensend, size_t r, size_t n) {
-  static random_device rd;
-  static mt19937 g(rd());
-  using PermT = typename RandIt::value_type;
-  vector<PermT> x;
-  PermT x0;
-
+ProductReplacement<PermT>::ProductReplacement(RandIt gensbeg, RandIt gensend,
+                                              Xoshiro256 rng, size_t r,
+                                              size_t n)
+    : rng_(rng) {
+  if (gensbeg == gensend)
+    throw invalid_argument("Product replacement needs generators");
   if (r < 2)
     r = max<size_t>(10, distance(gensbeg, gensend));
 
-  while (x.size() < r)
+  x_.reserve(r);
+  while (x_.size() < r)
     for (auto git = gensbeg; git != gensend; ++git)
-      if (x.size() < r)
-        x.push_back(*git);
-
-  auto randget = [r, x, x0]() mutable {
-    size_t s = g() % r;
-    size_t t = g() % (r - 1);
-    if (t >= s)
-      t = (t + 1) % r;
-    size_t b = g() % 2;
-    int e = (g() % 2) * 2 - 1;
-
-    if (b == 0) {
-      x[s].rmul(perm_pow(x[t], e));
-      x0.rmul(x[s]);
-    } else {
-      x[s].lmul(perm_pow(x[t], e));
-      x0.lmul(x[s]);
-    }
-
-    return x0;
-  };
+      if (x_.size() < r)
+        x_.push_back(*git);
 
   while (n-- > 0)
-    randget();
+    (*this)();
+}
+
+template <typename PermT> PermT ProductReplacement<PermT>::operator()() {
+  size_t r = x_.size();
+  size_t s = rng_.below(r);
+  size_t t = rng_.below(r - 1);
+  if (t >= s)
+    t = (t + 1) % r;
+  uint64_t bits = rng_();
+  bool left = bits & 1;
+  int e = (bits & 2) ? 1 : -1;
+
+  if (!left) {
+    x_[s].rmul(perm_pow(x_[t], e));
+    x0_.rmul(x_[s]);
+  } else {
+    x_[s].lmul(perm_pow(x_[t], e));
+    x0_.lmul(x_[s]);
+  }
+
+  return x0_;
+}
+
+template <typename RandIt, typename OutRandIt>
+void random_elements(RandIt gensbeg, RandIt gensend, size_t n, OutRandIt out,
+                     uint64_t seed, size_t nthreads) {
+  using PermT = typename std::iterator_traits<RandIt>::value_type;
+  // block is large enough to pay for its burn-in
+  constexpr size_t block = 1024;
+  size_t nblocks = (n + block - 1) / block;
+
+  parallel_for(nblocks, nthreads, [&](size_t, size_t beg, size_t fin) {
+    if (beg == fin)
+      return;
+    Xoshiro256 rng(seed, beg);
+    for (size_t k = beg; k != fin; ++k, rng.jump()) {
+      ProductReplacement<PermT> pr(gensbeg, gensend, rng, 0, 50);
+      size_t first = k * block;
+      pr.fill(min(block, n - first), out + first);
+    }
+  });
+}
 
-  return randget;
+template <typename RandIt>
+auto random_init(RandIt gensbeg, RandIt gensend, size_t r, size_t n) {
+  using PermT = typename std::iterator_traits<RandIt>::value_type;
+  random_device rd;
+  uint64_t seed = (uint64_t{rd()} << 32) ^ rd();
+  return [pr = ProductReplacement<PermT>(gensbeg, gensend, seed, 0, r,
+                                         n)]() mutable { return pr(); };
 }
 
 template <typename RandIt, typename OutIt>
 size_t all_elements(RandIt gensbeg, RandIt gensend, OutIt results) {
   auto id = gensbeg->id();
-  set<decltype(id)> next{id};
-  set<decltype(id)> total;
-  while (!next.empty()) {
-    set<decltype(id)> tmp;
-    total.insert(next.begin(), next.end());
-    for (auto &&elem : next)
-      for (auto igen = gensbeg; igen != gensend; ++igen)
-        if (auto newelem = product(elem, *igen); total.count(newelem) == 0)
-          tmp.insert(newelem);
-    next.swap(tmp);
-  }
+  // entries are kept in insertion order, so set itself is BFS queue
+  FlatSet<decltype(id)> total{id};
+  for (size_t i = 0; i != total.size(); ++i)
+    for (auto igen = gensbeg; igen != gensend; ++igen)
+      total.insert(product(total.keys()[i], *igen));
   for (auto &&elt : total)
     *results++ = elt;
   return total.size();
 }
 
-template <typename T, typename RandIt>
-auto primitive_blocks(T num1, T num2, RandIt gensbeg, RandIt gensend) {
-  map<T, size_t> classes;
-  map<size_t, T> reps;
-  queue<T> q;
-  assert(num1 != num2);
-  classes[num1] = 0;
-  classes[num2] = 0;
-  reps[0] = num1;
-  q.push(num2);
-  size_t classnum = 1;
-
-  for (auto elem = T::start; elem <= T::fin; ++elem) {
-    if ((elem == num1) || (elem == num2))
-      continue;
-    classes[elem] = classnum;
-    reps[classnum] = elem;
-    classnum += 1;
+template <typename RandIt, typename OutIt>
+size_t all_elements_parallel(RandIt gensbeg, RandIt gensend, OutIt results,
+                             size_t nthreads) {
+  auto id = gensbeg->id();
+  using PermT = decltype(id);
+  if (nthreads == 0)
+    nthreads = max<size_t>(1, thread::hardware_concurrency());
+
+  // visited set is split by hash into shards, each under its own lock
+  // high bits select shard, flat set probing uses low bits
+  size_t nshards = 1;
+  while (nshards < nthreads * 16)
+    nshards *= 2;
+  vector<FlatSet<PermT>> shards(nshards);
+  vector<mutex> locks(nshards);
+  auto shard_of = [nshards](const PermT &p) {
+    return (mix_hash(std::hash<PermT>{}(p)) >> 32) & (nshards - 1);
+  };
+
+  shards[shard_of(id)].insert(id);
+  vector<PermT> frontier{id};
+  while (!frontier.empty()) {
+    vector<vector<PermT>> found(nthreads);
+    parallel_for(frontier.size(), nthreads,
+                 [&](size_t tid, size_t beg, size_t fin) {
+                   for (size_t i = beg; i != fin; ++i)
+                     for (auto igen = gensbeg; igen != gensend; ++igen) {
+                       auto newelem = product(frontier[i], *igen);
+                       size_t sh = shard_of(newelem);
+                       bool isnew;
+                       {
+                         lock_guard<mutex> lk{locks[sh]};
+                         isnew = shards[sh].insert(newelem).second;
+                       }
+                       if (isnew)
+                         found[tid].push_back(move(newelem));
+                     }
+                 });
+    frontier.clear();
+    for (auto &f : found)
+      frontier.insert(frontier.end(), make_move_iterator(f.begin()),
+                      make_move_iterator(f.end()));
   }
 
-  while (!q.empty()) {
-    auto gamma = q.front();
-    q.pop();
-    for (auto igen = gensbeg; igen != gensend; ++igen) {
-      auto delta = reps[classes[gamma]];
-      auto c1 = classes[igen->apply(gamma)];
-      auto c2 = classes[igen->apply(delta)];
-      auto kappa = reps[c1];
-      auto lambda = reps[c2];
-      if (kappa != lambda) {
-        if (c1 > c2) {
-          swap(c1, c2); // now c1 < c2
-          swap(kappa, lambda);
-        }
-        for (auto &c : classes)
-          if (c.second == c2)
-            c.second = c1;
-        reps[c1] = kappa; // because we might swap
-        q.push(lambda);
-      }
+  size_t total = 0;
+  for (auto &&shard : shards) {
+    for (auto &&elt : shard)
+      *results++ = elt;
+    total += shard.size();
+  }
+  return total;
+}
+
+// zero-based image tables of generators, imgs[k * n + x] is image of x under
+// k-th generator
+template <typename RandIt> vector<uint32_t> gen_tables(RandIt gensbeg,
+                                                      RandIt gensend) {
+  using T = typename std::iterator_traits<RandIt>::value_type::value_type;
+  size_t n = T::fin - T::start + 1;
+  vector<uint32_t> imgs;
+  imgs.reserve(n * distance(gensbeg, gensend));
+  for (auto igen = gensbeg; igen != gensend; ++igen)
+    for (size_t x = 0; x != n; ++x)
+      imgs.push_back(igen->apply(static_cast<T>(T::start + x)) - T::start);
+  return imgs;
+}
+
+// Atkinson's algorithm over union-find with path compression and union by
+// rank, points are zero-based. Each merge queues point which stopped being
+// representative, so there are at most n - 1 merges and n - 1 queued points
+// afterwards find(x) gives class of x, returns size of class of a
+class BlockFinder {
+  size_t n_;
+  const vector<uint32_t> &imgs_;
+  vector<uint32_t> parent_;
+  vector<uint8_t> rank_;
+  vector<uint32_t> queue_;
+
+public:
+  BlockFinder(size_t n, const vector<uint32_t> &imgs)
+      : n_(n), imgs_(imgs), parent_(n), rank_(n) {}
+
+  size_t run(uint32_t a, uint32_t b);
+
+  uint32_t find(uint32_t x) {
+    while (parent_[x] != x) {
+      parent_[x] = parent_[parent_[x]];
+      x = parent_[x];
     }
+    return x;
   }
 
-  // TODO: this lengthy final part only transforms map { a => b } to
-  //       vector of vector of a for different b-s.
-  //       I believe, I can do it better.
-
-  classes_t<T> outcv;
-
-  vector<pair<T, size_t>> classelems(classes.begin(), classes.end());
-  sort(classelems.begin(), classelems.end(),
-       [](auto a, auto b) { return a.second < b.second; });
-  auto current_class = classelems.front().second;
-  outcv.push_back({});
-  for (auto elt : classelems) {
-    if (elt.second != current_class) {
-      current_class = elt.second;
-      outcv.push_back({});
+private:
+  // returns point, which is no longer representative
+  uint32_t unite(uint32_t x, uint32_t y) {
+    if (rank_[x] < rank_[y])
+      swap(x, y);
+    parent_[y] = x;
+    if (rank_[x] == rank_[y])
+      rank_[x] += 1;
+    return y;
+  }
+};
+
+inline size_t BlockFinder::run(uint32_t a, uint32_t b) {
+  iota(parent_.begin(), parent_.end(), 0);
+  std::fill(rank_.begin(), rank_.end(), 0);
+  queue_.clear();
+  queue_.push_back(unite(a, b));
+
+  size_t ngens = imgs_.size() / n_;
+  for (size_t qi = 0; qi != queue_.size(); ++qi) {
+    uint32_t gamma = queue_[qi];
+    for (size_t k = 0; k != ngens; ++k) {
+      const uint32_t *img = &imgs_[k * n_];
+      uint32_t delta = find(gamma);
+      uint32_t kappa = find(img[gamma]);
+      uint32_t lambda = find(img[delta]);
+      if (kappa != lambda)
+        queue_.push_back(unite(kappa, lambda));
     }
-    outcv[outcv.size() - 1].push_back(elt.first);
   }
 
+  uint32_t ra = find(a);
+  size_t sz = 0;
+  for (uint32_t x = 0; x != n_; ++x)
+    sz += (find(x) == ra);
+  return sz;
+}
+
+// classes from union-find: class of a first, others by smallest element
+template <typename T>
+classes_t<T> collect_blocks(BlockFinder &bf, size_t n, uint32_t a) {
+  classes_t<T> outcv(1);
+  vector<size_t> clsnum(n, std::numeric_limits<size_t>::max());
+  clsnum[bf.find(a)] = 0;
+  for (uint32_t x = 0; x != n; ++x) {
+    auto &c = clsnum[bf.find(x)];
+    if (c == std::numeric_limits<size_t>::max()) {
+      c = outcv.size();
+      outcv.emplace_back();
+    }
+    outcv[c].push_back(static_cast<T>(T::start + x));
+  }
   return outcv;
 }
 
+template <typename T, typename RandIt>
+auto primitive_blocks(T num1, T num2, RandIt gensbeg, RandIt gensend) {
+  assert(num1 != num2);
+  size_t n = T::fin - T::start + 1;
+  auto imgs = gen_tables(gensbeg, gensend);
+  BlockFinder bf(n, imgs);
+  uint32_t a = num1 - T::start;
+  bf.run(a, num2 - T::start);
+  return collect_blocks<T>(bf, n, a);
+}
+
+template <typename RandIt>
+auto minimal_block_systems(RandIt gensbeg, RandIt gensend, size_t nthreads) {
+  using T = typename std::iterator_traits<RandIt>::value_type::value_type;
+  size_t n = T::fin - T::start + 1;
+  auto imgs = gen_tables(gensbeg, gensend);
+  vector<classes_t<T>> res;
+  if (n < 3)
+    return res;
+
+  // sizes of minimal blocks, containing 0 and b
+  vector<size_t> sz(n, 1);
+  parallel_for(n - 1, nthreads, [&](size_t, size_t beg, size_t fin) {
+    BlockFinder bf(n, imgs);
+    for (size_t b = beg + 1; b != fin + 1; ++b)
+      sz[b] = bf.run(0, b);
+  });
+
+  // block of 0 and b is minimal if every point in it gives the same block,
+  // it is reported for smallest such b
+  vector<size_t> cands;
+  for (size_t b = 1; b != n; ++b)
+    if (sz[b] < n)
+      cands.push_back(b);
+
+  vector<classes_t<T>> found(cands.size());
+  parallel_for(cands.size(), nthreads, [&](size_t, size_t beg, size_t fin) {
+    BlockFinder bf(n, imgs);
+    for (size_t c = beg; c != fin; ++c) {
+      size_t b = cands[c];
+      bf.run(0, b);
+      auto blocks = collect_blocks<T>(bf, n, 0);
+      const auto &blk = blocks.front();
+      if (blk[1] - T::start != b)
+        continue;
+      if (all_of(blk.begin() + 1, blk.end(),
+                 [&](T x) { return sz[x - T::start] == sz[b]; }))
+        found[c] = move(blocks);
+    }
+  });
+
+  for (auto &f : found)
+    if (!f.empty())
+      res.push_back(move(f));
+  return res;
+}
+
 template <typename Perm, typename BaseIt, typename DeltaIt>
 auto strip(Perm g, BaseIt bstart, BaseIt bfin, DeltaIt dstart) {
   auto h = g;
@@ -199,8 +482,7 @@ auto strip(Perm g, BaseIt bstart, BaseIt bfin, DeltaIt dstart) {
     auto beta = h.apply(*bit);
     if (!dit->contains(beta))
       return make_pair(h, bit);
-    auto u_beta = dit->ubeta(beta);
-    h.rmul(invert(u_beta)); // h = h * (ui)^(-1)
+    dit->sift(h, beta); // h = h * (ui)^(-1)
   }
   return make_pair(h, bfin);
 }
@@ -219,11 +501,7 @@ auto try_newgen(Gen newgen, BaseIt bstart, BaseIt bfin, DeltaIt dstart) {
   if ((itj == bfin) && (h != h.id())) {
     need_extend_base = true;
     // looking for elt, moved by h
-    auto itnonprim = find_if(h.rbegin(), h.rend(), [](const auto &elt) {
-      return !elt.is_primitive();
-    });
-    assert(itnonprim != h.rend());
-    gamma = itnonprim->smallest();
+    gamma = h.smallest_moved();
 
     if (find(bstart, bfin, gamma) != bfin)
       throw logic_error("Can not add duplicating gamma");
@@ -243,10 +521,10 @@ auto extend_base(size_t curidx, BaseIt Base, BaseIt BaseEnd, SetIt Gens,
   for (auto &&beta : Delta[curidx]) {
     auto u_beta = Delta[curidx].ubeta(beta);
     for (auto &&x : Gens[curidx]) {
-      auto ub_x = product(u_beta, x);
-      auto u_bx = Delta[curidx].ubeta(x.apply(beta));
-      if (ub_x != u_bx) {
-        auto newgen = product(ub_x, invert(u_bx));
+      // schreier generator u_beta * x * (u_bx)^(-1), trivial iff ub_x == u_bx
+      auto newgen = product(u_beta, x);
+      Delta[curidx].sift(newgen, x.apply(beta));
+      if (newgen != newgen.id()) {
         auto[recalc, extend, gamma, newidx, h] =
             try_newgen(newgen, Base, BaseEnd, Delta);
         if (recalc)
@@ -255,46 +533,88 @@ auto extend_base(size_t curidx, BaseIt Base, BaseIt BaseEnd, SetIt Gens,
     }
   }
 
+  // generators set may be empty for redundant base point
+  using PermT = std::decay_t<decltype(*Gens[curidx].begin())>;
   return make_tuple(false, false, size_t(0), typename BaseIt::value_type{},
-                    Gens[curidx][0].id());
+                    PermT{});
 }
 
-template <template <class> class OrbT, typename RandIt>
-auto shreier_sims(RandIt gensbeg, RandIt gensend) {
-  using T = typename RandIt::value_type::value_type;
-  gensets_t<T> S;
-  vector<T> B;
-  vector<OrbT<T>> DeltaStar;
-
-  // in terms of book, S1 = S
-  S.emplace_back(gensbeg, gensend);
-
-  // looking for first base element. It shall not be fixed by all generators
-  for (auto b = T::start; b <= T::fin; ++b)
-    if (find_if(gensbeg, gensend, [b](const auto &elt) {
-          return elt.apply(b) == b;
-        }) == gensend) {
-      B.push_back(b);
-      break;
-    }
+// removing redundant generators on one level, see remove_redundant_gens
+// level i + 1 (if any) shall be already complete
+template <typename BaseIt, typename SetIt, typename DeltaIt>
+void remove_redundant_level(size_t i, BaseIt bstart, BaseIt bfin,
+                            SetIt sstart, DeltaIt dstart) {
+  using T = typename BaseIt::value_type;
+  using PermT = std::decay_t<decltype(sstart[i][0])>;
+  using OrbT = std::decay_t<decltype(dstart[i])>;
+
+  // generators of next level are kept, others are candidates for removal
+  vector<PermT> gens;
+  if (i + 1 < static_cast<size_t>(bfin - bstart))
+    gens = sstart[i + 1];
+  size_t nkept = gens.size();
+  for (auto &&s : sstart[i])
+    if (find(gens.begin(), gens.begin() + nkept, s) == gens.begin() + nkept)
+      gens.push_back(s);
+  bool changed = (gens.size() != sstart[i].size());
+
+  vector<char> removed(gens.size(), 0);
+  auto orbit_size = [&] {
+    vector<char> seen(T::fin - T::start + 1, 0);
+    vector<T> pts{bstart[i]};
+    seen[bstart[i] - T::start] = 1;
+    for (size_t p = 0; p != pts.size(); ++p)
+      for (size_t g = 0; g != gens.size(); ++g) {
+        if (removed[g])
+          continue;
+        if (auto x = gens[g].apply(pts[p]); !seen[x - T::start]) {
+          seen[x - T::start] = 1;
+          pts.push_back(x);
+        }
+      }
+    return pts.size();
+  };
 
-  if (B.empty())
-    throw logic_error("Domain for Schreier-Sims shall have at least one element"
-                      " not fixed by all generators");
+  size_t full = dstart[i].size();
+  for (size_t c = gens.size(); c-- > nkept;) {
+    removed[c] = 1;
+    if (orbit_size() != full)
+      removed[c] = 0;
+    else
+      changed = true;
+  }
 
-  // TODO: we may extend algorithm to start from non-void B, but not now
-  assert(B.size() == S.size());
-  assert(B.size() == 1);
+  if (!changed)
+    return;
 
-  DeltaStar.emplace_back(B[0], S[0].begin(), S[0].end());
+  vector<PermT> newgens;
+  for (size_t g = 0; g != gens.size(); ++g)
+    if (!removed[g])
+      newgens.push_back(move(gens[g]));
+  sstart[i] = move(newgens);
+  dstart[i] = OrbT(bstart[i], sstart[i].begin(), sstart[i].end());
+}
 
-  int curidx = static_cast<int>(B.size() - 1);
+template <typename BaseIt, typename SetIt, typename DeltaIt>
+void remove_redundant_gens(BaseIt bstart, BaseIt bfin, SetIt sstart,
+                           DeltaIt dstart) {
+  for (size_t i = bfin - bstart; i-- > 0;)
+    remove_redundant_level(i, bstart, bfin, sstart, dstart);
+}
 
+// core loop of shreier_sims: levels after curidx shall be complete
+// completes levels curidx .. 0, extending B, S and Delta* as required
+template <typename T, typename PermT, typename OrbT>
+void shreier_sims_complete(int curidx, vector<T> &B, vector<vector<PermT>> &S,
+                           vector<OrbT> &DeltaStar) {
   while (curidx != -1) {
     auto[succ, extend, newidx, gamma, h] =
         extend_base(curidx, B.begin(), B.end(), S.begin(), DeltaStar.begin());
 
     if (!succ) {
+      // level is complete, so are all after it
+      remove_redundant_level(curidx, B.begin(), B.end(), S.begin(),
+                             DeltaStar.begin());
       curidx -= 1;
       continue;
     }
@@ -320,7 +640,264 @@ auto shreier_sims(RandIt gensbeg, RandIt gensend) {
 
     curidx = newidx;
   }
+}
+
+template <template <class...> class OrbT, typename RandIt>
+auto shreier_sims(RandIt gensbeg, RandIt gensend) {
+  using PermT = typename RandIt::value_type;
+  using T = typename PermT::value_type;
+
+  // looking for first base element. It shall not be fixed by all generators
+  for (auto b = T::start; b <= T::fin; ++b)
+    if (find_if(gensbeg, gensend, [b](const auto &elt) {
+          return elt.apply(b) == b;
+        }) == gensend) {
+      vector<T> B{b};
+      return shreier_sims<OrbT>(gensbeg, gensend, B.begin(), B.end());
+    }
+
+  throw logic_error("Domain for Schreier-Sims shall have at least one element"
+                    " not fixed by all generators");
+}
+
+template <template <class...> class OrbT, typename RandIt, typename BaseIt>
+auto shreier_sims(RandIt gensbeg, RandIt gensend, BaseIt bbeg, BaseIt bend) {
+  using PermT = typename RandIt::value_type;
+  using T = typename PermT::value_type;
+  vector<T> B;
+  for (auto bit = bbeg; bit != bend; ++bit)
+    if (find(B.begin(), B.end(), *bit) == B.end())
+      B.push_back(*bit);
+
+  // every non-trivial generator shall move some base point
+  for (auto git = gensbeg; git != gensend; ++git)
+    if (all_of(B.begin(), B.end(),
+               [git](const T &b) { return git->apply(b) == b; }) &&
+        (*git != git->id()))
+      B.push_back(git->smallest_moved());
+
+  if (B.empty())
+    throw logic_error("Schreier-Sims needs base point or non-trivial "
+                      "generator");
+
+  // S[i] is generators, fixing b[0] .. b[i-1], in terms of book S1 = S
+  vector<vector<PermT>> S(B.size());
+  vector<OrbT<T, PermT>> DeltaStar;
+  for (size_t i = 0; i != B.size(); ++i) {
+    for (auto git = gensbeg; git != gensend; ++git)
+      if (all_of(B.begin(), B.begin() + i,
+                 [git](const T &b) { return git->apply(b) == b; }))
+        S[i].push_back(*git);
+    DeltaStar.emplace_back(B[i], S[i].begin(), S[i].end());
+  }
+
+  shreier_sims_complete(static_cast<int>(B.size() - 1), B, S, DeltaStar);
+  return make_tuple(B, S, DeltaStar);
+}
+
+template <typename T, typename PermT, typename OrbT>
+bool shreier_sims_extend(vector<T> &B, vector<vector<PermT>> &S,
+                         vector<OrbT> &DeltaStar, const PermT &g) {
+  auto[h, itj] = strip(g, B.begin(), B.end(), DeltaStar.begin());
+  if ((itj == B.end()) && (h == h.id()))
+    return false;
+
+  // g fixes b[0] .. b[j-1], so it belongs to all G[0] .. G[j]
+  size_t j = 0;
+  while ((j != B.size()) && (g.apply(B[j]) == B[j]))
+    j += 1;
+
+  if (j == B.size()) {
+    B.push_back(g.smallest_moved());
+    S.emplace_back();
+    DeltaStar.emplace_back(B.back(), S.back().begin(), S.back().end());
+  }
+
+  for (size_t l = 0; l <= j; ++l) {
+    S[l].push_back(g);
+    DeltaStar[l].extend_orbit(g);
+  }
+
+  shreier_sims_complete(static_cast<int>(j), B, S, DeltaStar);
+  return true;
+}
+
+template <typename T, typename PermT, typename OrbT>
+void base_swap(size_t i, vector<T> &B, vector<vector<PermT>> &S,
+               vector<OrbT> &DeltaStar) {
+  assert(i + 1 < B.size());
+  T bi = B[i], bi1 = B[i + 1];
+
+  // new orbits: of b[i+1] in G[i] and of b[i] in its stabilizer Theta
+  // Theta starts from G[i+2] and grows until size is known one
+  OrbT newdelta(bi1, S[i].begin(), S[i].end());
+  size_t target = DeltaStar[i].size() * DeltaStar[i + 1].size() /
+                  newdelta.size();
+  vector<PermT> tgens;
+  if (i + 2 < B.size())
+    tgens = S[i + 2];
+  OrbT theta(bi, tgens.begin(), tgens.end());
+
+  // Gamma is points of Delta[i], not yet excluded
+  vector<char> out(T::fin - T::start + 1, 0);
+  auto exclude = [&](T start) {
+    vector<T> pts{start};
+    out[start - T::start] = 1;
+    for (size_t p = 0; p != pts.size(); ++p)
+      for (auto &&t : tgens)
+        if (auto x = t.apply(pts[p]); !out[x - T::start]) {
+          out[x - T::start] = 1;
+          pts.push_back(x);
+        }
+  };
+  exclude(bi);
+
+  vector<T> gamma;
+  for (auto &&x : DeltaStar[i])
+    gamma.push_back(x);
+  for (size_t gi = 0; gi != gamma.size() && theta.size() < target; ++gi) {
+    T gm = gamma[gi];
+    if (out[gm - T::start])
+      continue;
+
+    // g maps b[i] to gamma, y * g shall fix b[i+1]
+    auto g = DeltaStar[i].ubeta(gm);
+    T p = invert(g).apply(bi1);
+    if (!DeltaStar[i + 1].contains(p)) {
+      exclude(gm);
+      continue;
+    }
+
+    auto yg = product(DeltaStar[i + 1].ubeta(p), g);
+    tgens.push_back(yg);
+    theta.extend_orbit(yg);
+    for (auto &&x : theta)
+      out[x - T::start] = 1;
+  }
+  assert(theta.size() == target);
+
+  B[i] = bi1;
+  B[i + 1] = bi;
+  S[i + 1] = move(tgens);
+  DeltaStar[i] = move(newdelta);
+  DeltaStar[i + 1] = move(theta);
+}
+
+template <typename T, typename PermT, typename OrbT, typename BaseIt>
+void change_base(vector<T> &B, vector<vector<PermT>> &S,
+                 vector<OrbT> &DeltaStar, BaseIt nbeg, BaseIt nend) {
+  size_t j = 0;
+  for (auto nit = nbeg; nit != nend; ++nit) {
+    size_t pos = find(B.begin(), B.end(), *nit) - B.begin();
+    if (pos < j)
+      continue;
+
+    // new point comes as redundant level, then goes up
+    if (pos == B.size()) {
+      B.push_back(*nit);
+      S.emplace_back();
+      DeltaStar.emplace_back(B.back(), S.back().begin(), S.back().end());
+    }
+    for (size_t p = pos; p > j; --p)
+      base_swap(p - 1, B, S, DeltaStar);
+    j += 1;
+  }
+
+  for (size_t l = B.size(); l-- > j;)
+    if (DeltaStar[l].size() == 1) {
+      B.erase(B.begin() + l);
+      S.erase(S.begin() + l);
+      DeltaStar.erase(DeltaStar.begin() + l);
+    }
+}
+
+// orbit has conjugate(c)
+template <typename OrbT, typename PermT, typename = void>
+struct has_conjugate : std::false_type {};
+
+template <typename OrbT, typename PermT>
+struct has_conjugate<OrbT, PermT,
+                     std::void_t<decltype(std::declval<OrbT &>().conjugate(
+                         std::declval<const PermT &>()))>> : std::true_type {};
+
+template <typename T, typename PermT, typename OrbT>
+void conjugate_chain(vector<T> &B, vector<vector<PermT>> &S,
+                     vector<OrbT> &DeltaStar, const PermT &c) {
+  auto cinv = invert(c);
+  for (size_t i = 0; i != B.size(); ++i) {
+    B[i] = c.apply(B[i]);
+    for (auto &s : S[i])
+      s = product(product(cinv, s), c);
+    if constexpr (has_conjugate<OrbT, PermT>::value)
+      DeltaStar[i].conjugate(c);
+    else
+      DeltaStar[i] = OrbT(B[i], S[i].begin(), S[i].end());
+  }
+}
+
+template <typename DeltaIt>
+uint64_t group_order(DeltaIt dstart, DeltaIt dfin) {
+  uint64_t order = 1;
+  for (auto dit = dstart; dit != dfin; ++dit) {
+    uint64_t sz = dit->size();
+    if (order > std::numeric_limits<uint64_t>::max() / sz)
+      throw overflow_error("Group order do not fit in 64 bits");
+    order *= sz;
+  }
+  return order;
+}
+
+template <template <class...> class OrbT, typename RandIt>
+auto random_shreier_sims(RandIt gensbeg, RandIt gensend, size_t nsucc,
+                         uint64_t known_order, optional<uint64_t> seed) {
+  using PermT = typename RandIt::value_type;
+  using T = typename PermT::value_type;
+  vector<vector<PermT>> S;
+  vector<T> B;
+  vector<OrbT<T, PermT>> DeltaStar;
+
+  S.emplace_back(gensbeg, gensend);
+  auto git = find_if(gensbeg, gensend,
+                     [](const PermT &g) { return g != g.id(); });
+  if (git == gensend)
+    throw logic_error("Randomized Schreier-Sims needs non-trivial generator");
+  B.push_back(git->smallest_moved());
+  DeltaStar.emplace_back(B[0], S[0].begin(), S[0].end());
+
+  if (!seed) {
+    random_device rd;
+    seed = (uint64_t{rd()} << 32) ^ rd();
+  }
+  ProductReplacement<PermT> xrand(gensbeg, gensend, *seed);
+  size_t nstripped = 0;
+  while (nstripped < nsucc) {
+    // chain is for subgroup, so it can not overflow known order
+    if ((known_order != 0) &&
+        (group_order(DeltaStar.begin(), DeltaStar.end()) == known_order))
+      break;
+
+    auto[h, itj] = strip(xrand(), B.begin(), B.end(), DeltaStar.begin());
+    size_t j = itj - B.begin();
+    if ((itj == B.end()) && (h == h.id())) {
+      nstripped += 1;
+      continue;
+    }
+
+    // h fixes b[0] .. b[j-1], so it belongs to all G[0] .. G[j]
+    nstripped = 0;
+    for (size_t l = 0; l != min(j + 1, B.size()); ++l) {
+      S[l].push_back(h);
+      DeltaStar[l].extend_orbit(h);
+    }
+
+    if (itj == B.end()) {
+      B.push_back(h.smallest_moved());
+      S.push_back({h});
+      DeltaStar.emplace_back(B.back(), S.back().begin(), S.back().end());
+    }
+  }
 
+  remove_redundant_gens(B.begin(), B.end(), S.begin(), DeltaStar.begin());
   return make_tuple(B, S, DeltaStar);
 }
 
@@ -4,11 +4,24 @@
 //
 //------------------------------------------------------------------------------
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "backtrack.hpp"
+#include "bsgs.hpp"
 #include "groups.hpp"
 #include "idomain.hpp"
+#include "permpacked.hpp"
+#include "stabchain.hpp"
 
+using orbits::CachedShreierOrbit;
 using orbits::DirectOrbit;
+using orbits::FlatDirectOrbit;
+using orbits::FlatShreierOrbit;
+using orbits::ShallowShreierOrbit;
 using orbits::ShreierOrbit;
+using permutations::PackedPermutation;
 using namespace groupgens;
 using namespace groups;
 
@@ -32,10 +45,33 @@ int test_primitive_blocks() {
   vector<vector<UD6>> ref2 = {{1, 4}, {2, 5}, {3, 6}};
   simple_check(bs2 == ref2);
 
+  // class of first point goes first even if it is not smallest
+  auto bs3 = primitive_blocks(UD6{4}, UD6{1}, gens.begin(), gens.end());
+  vector<vector<UD6>> ref3 = {{1, 4}, {2, 5}, {3, 6}};
+  simple_check(bs3 == ref3);
+  auto bs4 = primitive_blocks(UD6{2}, UD6{1}, gens.begin(), gens.end());
+  simple_check(bs4.size() == 1 && bs4[0].size() == 6);
+
+  // both systems of hexagon are minimal
+  auto mbs = minimal_block_systems(gens.begin(), gens.end(), 2);
+  simple_check(mbs.size() == 2);
+  simple_check(mbs[0] == ref1 && mbs[1] == ref2);
+
+  // cyclic group of order 8 has blocks of size 2 and 4, only first minimal
+  using UD8 = UnsignedDomain<1, 8>;
+  auto cgens = cyclic_gens<UD8>();
+  auto cbs = minimal_block_systems(cgens.begin(), cgens.end());
+  vector<vector<UD8>> cref = {{1, 5}, {2, 6}, {3, 7}, {4, 8}};
+  simple_check(cbs.size() == 1 && cbs[0] == cref);
+
+  // symmetric group is primitive
+  auto sgens = symmetric_gens<UD6>();
+  simple_check(minimal_block_systems(sgens.begin(), sgens.end()).empty());
+
   return 0;
 }
 
-template <template <class> class OrbT> int test_strip() {
+template <template <class...> class OrbT> int test_strip() {
   cout << "Strip tests" << endl;
   using UD5 = UnsignedDomain<1, 5>;
   using RandIt = typename gens_t<UD5>::iterator;
@@ -82,23 +118,18 @@ template <template <class> class OrbT> int test_strip() {
     }
   }
 
-// TODO: a lot of excessive gens in S. Cleanup by HCGT routine?
-#if 0
-  cout << "S" << endl;
-  for (auto &&gens : S) {
-    cout << " --- " << endl;
-    for (auto &&g : gens)
-      cout << g << endl;
+  // redundant strong generators are removed, but each level still
+  // generates its stabilizer
+  for (size_t i = 0; i < S.size(); ++i) {
+    simple_check(S[i].size() <= 3);
+    set<Permutation<UD5>> gi;
+    all_elements(S[i].begin(), S[i].end(), std::inserter(gi, gi.end()));
+    size_t order = 1;
+    for (size_t j = i; j < Delta.size(); ++j)
+      order *= Delta[j].size();
+    simple_check(gi.size() == order);
   }
 
-  cout << "Sref" << endl;
-  for (auto &&gens : Sref) {
-    cout << " --- " << endl;
-    for (auto &&g : gens)
-      cout << g << endl;
-  }
-#endif
-
   // test that all element in group stripped to end()
   for (auto &&x : all) {
     auto res = strip(x, B.begin(), B.end(), Delta.begin());
@@ -120,7 +151,7 @@ template <template <class> class OrbT> int test_strip() {
   return 0;
 }
 
-template <template <class> class OrbT> int test_shreier_sims() {
+template <template <class...> class OrbT> int test_shreier_sims() {
   cout << "Schreier-Sims tests" << endl;
 
   using UD5 = UnsignedDomain<1, 5>;
@@ -132,9 +163,7 @@ template <template <class> class OrbT> int test_shreier_sims() {
   simple_check(B.size() == 4);
 
   // now we can get order of group as product of Deltas
-  size_t gorder = 1;
-  for (auto &&d : Delta)
-    gorder *= d.size();
+  size_t gorder = group_order(Delta.begin(), Delta.end());
 
   // Sym(5) size is 120
   simple_check(gorder == 120);
@@ -151,9 +180,7 @@ template <template <class> class OrbT> int test_shreier_sims() {
   auto[BA, SA, DeltaA] = shreier_sims<OrbT>(agens.begin(), agens.end());
   simple_check(BA.size() == 3);
 
-  gorder = 1;
-  for (auto &&d : DeltaA)
-    gorder *= d.size();
+  gorder = group_order(DeltaA.begin(), DeltaA.end());
 
   // Alt(5) size is 60
   simple_check(gorder == 60);
@@ -172,9 +199,7 @@ template <template <class> class OrbT> int test_shreier_sims() {
   gens_t<UD5> xgens = {a, b};
   auto[BX, SX, DeltaX] = shreier_sims<OrbT>(xgens.begin(), xgens.end());
 
-  gorder = 1;
-  for (auto &&d : DeltaX)
-    gorder *= d.size();
+  gorder = group_order(DeltaX.begin(), DeltaX.end());
 
   simple_check(gorder == 20);
 
@@ -189,6 +214,659 @@ template <template <class> class OrbT> int test_shreier_sims() {
   return 0;
 }
 
+template <template <class...> class OrbT, template <class> class PermT>
+int test_dense_shreier_sims() {
+  cout << "Dense Schreier-Sims tests" << endl;
+
+  using UD6 = UnsignedDomain<1, 6>;
+  using DP = PermT<UD6>;
+
+  // same groups, dense generators
+  auto sgens = symmetric_gens<UD6>();
+  vector<DP> dsgens(sgens.begin(), sgens.end());
+  auto[B, S, Delta] = shreier_sims<OrbT>(dsgens.begin(), dsgens.end());
+
+  size_t gorder = group_order(Delta.begin(), Delta.end());
+
+  // Sym(6) size is 720
+  simple_check(gorder == 720);
+
+  auto agens = alternating_gens<UD6>();
+  vector<DP> dagens(agens.begin(), agens.end());
+  auto[BA, SA, DeltaA] = shreier_sims<OrbT>(dagens.begin(), dagens.end());
+
+  gorder = group_order(DeltaA.begin(), DeltaA.end());
+
+  // Alt(6) size is 360
+  simple_check(gorder == 360);
+
+  // every element of Sym(6) strips to id iff it is even
+  set<DP> allsym;
+  all_elements(dsgens.begin(), dsgens.end(),
+               std::inserter(allsym, allsym.end()));
+  simple_check(allsym.size() == 720);
+
+  set<DP> allalt;
+  all_elements(dagens.begin(), dagens.end(),
+               std::inserter(allalt, allalt.end()));
+  simple_check(allalt.size() == 360);
+
+  // parallel enumeration gives the same elements, each once
+  for (size_t nthreads : {1, 4}) {
+    vector<DP> parsym;
+    size_t nsym = all_elements_parallel(dsgens.begin(), dsgens.end(),
+                                        back_inserter(parsym), nthreads);
+    simple_check(nsym == 720 && parsym.size() == 720);
+    simple_check(set<DP>(parsym.begin(), parsym.end()) == allsym);
+  }
+
+  for (auto &&x : allsym) {
+    auto res = strip(x, BA.begin(), BA.end(), DeltaA.begin());
+    bool member = (res.first == x.id() && res.second == BA.end());
+    simple_check(member == (allalt.count(x) != 0));
+  }
+
+  auto xrand = random_init(dagens.begin(), dagens.end());
+  for (int x = 0; x < 10; ++x)
+    simple_check(allalt.count(xrand()) != 0);
+
+  return 0;
+}
+
+// runtime degree n, every degree has its own Tag
+template <template <class...> class OrbT, unsigned n>
+void check_runtime_degree(size_t order) {
+  using RD = UnsignedRuntimeDomain<std::integral_constant<unsigned, n>>;
+  RD::set_bounds(1, n);
+
+  auto sgens = symmetric_gens<RD>();
+  auto[B, S, Delta] = shreier_sims<OrbT>(sgens.begin(), sgens.end());
+  simple_check(group_order(Delta.begin(), Delta.end()) == order);
+
+  auto cgens = min_symmetric_gens<RD>();
+  vector<DensePermutation<RD>> dgens(cgens.begin(), cgens.end());
+  auto[BD, SD, DeltaD] = shreier_sims<OrbT>(dgens.begin(), dgens.end());
+  simple_check(group_order(DeltaD.begin(), DeltaD.end()) == order);
+
+  Permutation<RD> c{{1, 3, 2}};
+  auto res = strip(c, B.begin(), B.end(), Delta.begin());
+  simple_check(res.first == c.id() && res.second == B.end());
+}
+
+template <template <class...> class OrbT> int test_runtime_domain() {
+  cout << "Runtime domain tests" << endl;
+  using RD = UnsignedRuntimeDomain<>;
+
+  // bounds are set at runtime, but every degree needs its own Tag
+  check_runtime_degree<OrbT, 3>(6);
+  check_runtime_degree<OrbT, 5>(120);
+  check_runtime_degree<OrbT, 7>(5040);
+
+  // bounds, once set, are not changed
+  RD::set_bounds(1, 5);
+  RD::set_bounds(1, 5);
+  bool thrown = false;
+  try {
+    RD::set_bounds(1, 6);
+  } catch (std::logic_error &) {
+    thrown = true;
+  }
+  simple_check(thrown && RD::fin == 5);
+
+  // values out of current bounds are rejected in debug builds
+#ifndef NDEBUG
+  thrown = false;
+  try {
+    RD x = 6;
+    (void)x;
+  } catch (std::out_of_range &) {
+    thrown = true;
+  }
+  simple_check(thrown);
+#endif
+
+  return 0;
+}
+
+template <template <class...> class OrbT> int test_incremental_bsgs() {
+  cout << "Incremental BSGS tests" << endl;
+  using UD6 = UnsignedDomain<1, 6>;
+  using DP = DensePermutation<UD6>;
+
+  // Alt(6) generator by generator, then Sym(6)
+  auto agens = alternating_gens<UD6>();
+  vector<DP> dagens(agens.begin(), agens.end());
+  auto[B, S, Delta] = shreier_sims<OrbT>(dagens.begin(), dagens.begin() + 1);
+  for (auto git = dagens.begin() + 1; git != dagens.end(); ++git)
+    shreier_sims_extend(B, S, Delta, *git);
+  simple_check(group_order(Delta.begin(), Delta.end()) == 360);
+  simple_check(!shreier_sims_extend(B, S, Delta, dagens[0]));
+  simple_check(group_order(Delta.begin(), Delta.end()) == 360);
+
+  DP odd{{1, 2}};
+  simple_check(shreier_sims_extend(B, S, Delta, odd));
+  simple_check(group_order(Delta.begin(), Delta.end()) == 720);
+
+  // user-supplied base goes first
+  vector<UD6> ubase{6, 5};
+  auto[BU, SU, DeltaU] = shreier_sims<OrbT>(dagens.begin(), dagens.end(),
+                                            ubase.begin(), ubase.end());
+  simple_check(BU[0] == 6 && BU[1] == 5);
+  simple_check(group_order(DeltaU.begin(), DeltaU.end()) == 360);
+
+  // redundant base point with trivial orbit is kept
+  vector<DP> s4gens{{{1, 2}}, {{1, 2, 3, 4}}};
+  vector<UD6> rbase{6};
+  auto[BR, SR, DeltaR] = shreier_sims<OrbT>(s4gens.begin(), s4gens.end(),
+                                            rbase.begin(), rbase.end());
+  simple_check(BR[0] == 6 && DeltaR[0].size() == 1);
+  simple_check(group_order(DeltaR.begin(), DeltaR.end()) == 24);
+  auto res = strip(DP{{1, 3}}, BR.begin(), BR.end(), DeltaR.begin());
+  simple_check(res.first == DP{} && res.second == BR.end());
+  res = strip(DP{{1, 6}}, BR.begin(), BR.end(), DeltaR.begin());
+  simple_check(res.first != DP{} || res.second != BR.end());
+
+  return 0;
+}
+
+template <template <class...> class OrbT> int test_base_change() {
+  cout << "Base change tests" << endl;
+  using UD6 = UnsignedDomain<1, 6>;
+  using DP = DensePermutation<UD6>;
+
+  auto agens = alternating_gens<UD6>();
+  vector<DP> dagens(agens.begin(), agens.end());
+  auto[B, S, Delta] = shreier_sims<OrbT>(dagens.begin(), dagens.end());
+  vector<DP> elts;
+  all_elements(dagens.begin(), dagens.end(), back_inserter(elts));
+  simple_check(group_order(Delta.begin(), Delta.end()) == 360);
+
+  // every swap keeps group
+  for (size_t i = 0; i + 1 < B.size(); ++i) {
+    auto b0 = B[i], b1 = B[i + 1];
+    base_swap(i, B, S, Delta);
+    simple_check(B[i] == b1 && B[i + 1] == b0);
+    simple_check(group_order(Delta.begin(), Delta.end()) == 360);
+  }
+  for (auto &&e : elts) {
+    auto res = strip(e, B.begin(), B.end(), Delta.begin());
+    simple_check(res.first == DP{} && res.second == B.end());
+  }
+
+  // new base prefix, including points not in base
+  vector<UD6> nbase{6, 3, 5, 6};
+  change_base(B, S, Delta, nbase.begin(), nbase.end());
+  simple_check(B[0] == 6 && B[1] == 3 && B[2] == 5);
+  simple_check(group_order(Delta.begin(), Delta.end()) == 360);
+  for (auto &&e : elts) {
+    auto res = strip(e, B.begin(), B.end(), Delta.begin());
+    simple_check(res.first == DP{} && res.second == B.end());
+  }
+  auto res = strip(DP{{1, 2}}, B.begin(), B.end(), Delta.begin());
+  simple_check(res.first != DP{} || res.second != B.end());
+
+  // Sym(3) on 1, 2, 3 moved to 4, 5, 6
+  vector<DP> s3gens{{{1, 2}}, {{1, 2, 3}}};
+  auto[BC, SC, DeltaC] = shreier_sims<OrbT>(s3gens.begin(), s3gens.end());
+  conjugate_chain(BC, SC, DeltaC, DP{{1, 4}, {2, 5}, {3, 6}});
+  simple_check(group_order(DeltaC.begin(), DeltaC.end()) == 6);
+  simple_check(BC[0] >= 4);
+  res = strip(DP{{4, 5}}, BC.begin(), BC.end(), DeltaC.begin());
+  simple_check(res.first == DP{} && res.second == BC.end());
+  res = strip(DP{{1, 2}}, BC.begin(), BC.end(), DeltaC.begin());
+  simple_check(res.first != DP{} || res.second != BC.end());
+
+  return 0;
+}
+
+template <template <class...> class OrbT> int test_stab_chain() {
+  cout << "Stabilizer chain tests" << endl;
+  using UD6 = UnsignedDomain<1, 6>;
+  using DP = DensePermutation<UD6>;
+
+  auto agens = alternating_gens<UD6>();
+  vector<DP> dagens(agens.begin(), agens.end());
+  auto[B, S, Delta] = shreier_sims<OrbT>(dagens.begin(), dagens.end());
+  StabChain<DP> chain(B.begin(), B.end(), S.begin(), Delta.begin());
+  simple_check(chain.order() == 360);
+  simple_check(chain.nlevels() == B.size());
+  for (size_t i = 0; i != chain.nlevels(); ++i) {
+    simple_check(chain.base(i) == B[i]);
+    simple_check(chain.ngens(i) == S[i].size());
+    for (size_t j = 0; j != chain.orbit_size(i); ++j) {
+      auto x = chain.orbit_point(i, j);
+      simple_check(chain.ubeta(i, x).apply(B[i]) == x);
+    }
+  }
+
+  vector<DP> elts;
+  all_elements(dagens.begin(), dagens.end(), back_inserter(elts));
+  for (auto &&e : elts)
+    simple_check(chain.contains(e));
+
+  // odd permutations are not in Alt(6)
+  vector<DP> queries = elts;
+  for (auto &&e : elts)
+    queries.push_back(product(e, DP{{1, 2}}));
+  vector<char> res(queries.size());
+  size_t nin = chain.strip_all(queries.begin(), queries.end(), res.begin(), 4);
+  simple_check(nin == 360);
+  for (size_t k = 0; k != queries.size(); ++k)
+    simple_check(static_cast<bool>(res[k]) == (k < 360));
+
+  // loop form works the same way
+  vector<Permutation<UD6>> lgens(agens.begin(), agens.end());
+  auto[BL, SL, DeltaL] = shreier_sims<OrbT>(lgens.begin(), lgens.end());
+  StabChain<Permutation<UD6>> lchain(BL.begin(), BL.end(), SL.begin(),
+                                     DeltaL.begin());
+  simple_check(lchain.contains(Permutation<UD6>{{1, 2, 3}}));
+  simple_check(!lchain.contains(Permutation<UD6>{{1, 2}}));
+  simple_check(lchain.gen(0, 0) == SL[0][0]);
+
+  // serialized chain is same chain
+  stringstream ss;
+  chain.save(ss);
+  auto rchain = StabChain<DP>::read(ss);
+  simple_check(rchain.order() == 360 && rchain.nlevels() == chain.nlevels());
+  nin = rchain.strip_all(queries.begin(), queries.end(), res.begin(), 2);
+  simple_check(nin == 360);
+
+  string fname = "/tmp/cgt_grouptests_chain.bin";
+  {
+    std::ofstream ofs(fname, std::ios::binary);
+    chain.save(ofs);
+  }
+  auto mchain = StabChain<DP>::map_file(fname);
+  std::remove(fname.c_str());
+  simple_check(mchain.order() == 360);
+  for (size_t k = 0; k != queries.size(); ++k)
+    simple_check(mchain.contains(queries[k]) == (k < 360));
+  simple_check(mchain.ubeta(0, mchain.orbit_point(0, 1)) ==
+               chain.ubeta(0, chain.orbit_point(0, 1)));
+
+  // other domain or garbage is rejected
+  bool thrown = false;
+  try {
+    stringstream ls;
+    lchain.save(ls);
+    string bytes = ls.str();
+    bytes[0] ^= 1;
+    stringstream bs(bytes);
+    StabChain<Permutation<UD6>>::read(bs);
+  } catch (runtime_error &) {
+    thrown = true;
+  }
+  simple_check(thrown);
+
+  thrown = false;
+  try {
+    stringstream ls;
+    chain.save(ls);
+    StabChain<DensePermutation<UnsignedDomain<1, 7>>>::read(ls);
+  } catch (runtime_error &) {
+    thrown = true;
+  }
+  simple_check(thrown);
+
+  // any single broken word is found by validation or does not change
+  // membership, header with huge sizes gives runtime_error, not huge
+  // allocation
+  stringstream cs;
+  chain.save(cs);
+  string good = cs.str();
+  vector<uint32_t> words(good.size() / sizeof(uint32_t));
+  memcpy(words.data(), good.data(), good.size());
+  const size_t hpoints = 6;
+  auto same_or_rejected = [&](const vector<uint32_t> &w) {
+    stringstream bs(string(reinterpret_cast<const char *>(w.data()),
+                           w.size() * sizeof(uint32_t)));
+    try {
+      auto bchain = StabChain<DP>::read(bs);
+      for (size_t k = 0; k != queries.size(); ++k)
+        if (bchain.contains(queries[k]) != (k < 360))
+          return false;
+    } catch (runtime_error &) {
+    }
+    return true;
+  };
+  for (size_t pos = 0; pos != words.size(); ++pos)
+    for (uint32_t delta : {1u, 0x80000000u}) {
+      auto bad = words;
+      bad[pos] += delta;
+      simple_check(same_or_rejected(bad));
+    }
+  auto huge = words;
+  huge[hpoints] = 0xFFFFFFF0u;
+  stringstream hs(string(reinterpret_cast<const char *>(huge.data()),
+                         huge.size() * sizeof(uint32_t)));
+  thrown = false;
+  try {
+    StabChain<DP>::read(hs);
+  } catch (runtime_error &) {
+    thrown = true;
+  }
+  simple_check(thrown);
+
+  return 0;
+}
+
+int test_product_replacement() {
+  cout << "Product replacement tests" << endl;
+  using UD7 = UnsignedDomain<1, 7>;
+  using DP = DensePermutation<UD7>;
+
+  // streams of one seed do not coincide
+  Xoshiro256 r0(42), r1(42, 1), r0a(42);
+  simple_check(r0() == r0a());
+  simple_check(r0() != r1());
+  for (int i = 0; i != 1000; ++i)
+    simple_check(r0.below(7) < 7);
+
+  auto agens = alternating_gens<UD7>();
+  vector<DP> dagens(agens.begin(), agens.end());
+  ProductReplacement<DP> pa(dagens.begin(), dagens.end(), 17);
+  ProductReplacement<DP> pb(dagens.begin(), dagens.end(), 17);
+  ProductReplacement<DP> pc(dagens.begin(), dagens.end(), 17, 1);
+  vector<DP> va, vb, vc;
+  pa.fill(100, back_inserter(va));
+  pb.fill(100, back_inserter(vb));
+  pc.fill(100, back_inserter(vc));
+  simple_check(va == vb);
+  simple_check(va != vc);
+
+  // parallel result do not depend on number of threads
+  vector<DP> e1(3000), e3(3000);
+  random_elements(dagens.begin(), dagens.end(), e1.size(), e1.begin(), 5, 1);
+  random_elements(dagens.begin(), dagens.end(), e3.size(), e3.begin(), 5, 3);
+  simple_check(e1 == e3);
+
+  // all are from Alt(7) and they are spread over it
+  auto[B, S, Delta] =
+      shreier_sims<FlatShreierOrbit>(dagens.begin(), dagens.end());
+  FlatSet<DP> distinct;
+  for (auto &&e : e1) {
+    auto res = strip(e, B.begin(), B.end(), Delta.begin());
+    simple_check(res.first == DP{} && res.second == B.end());
+    distinct.insert(e);
+  }
+  simple_check(distinct.size() > 1000);
+
+  // seeded randomized Schreier-Sims is reproducible
+  auto[B1, S1, Delta1] = random_shreier_sims<FlatShreierOrbit>(
+      dagens.begin(), dagens.end(), 20, 0, 11);
+  auto[B2, S2, Delta2] = random_shreier_sims<FlatShreierOrbit>(
+      dagens.begin(), dagens.end(), 20, 0, 11);
+  simple_check(B1 == B2 && S1 == S2);
+
+  return 0;
+}
+
+template <template <class...> class OrbT> int test_random_shreier_sims() {
+  cout << "Random Schreier-Sims tests" << endl;
+  using UD7 = UnsignedDomain<1, 7>;
+  using DP = DensePermutation<UD7>;
+
+  // known order gives exact answer
+  auto sgens = min_symmetric_gens<UD7>();
+  vector<DP> dsgens(sgens.begin(), sgens.end());
+  auto[B, S, Delta] =
+      random_shreier_sims<OrbT>(dsgens.begin(), dsgens.end(), 1000, 5040);
+  simple_check(group_order(Delta.begin(), Delta.end()) == 5040);
+
+  // without it, result is only likely to be complete, so seed is fixed to
+  // keep test reproducible
+  auto agens = alternating_gens<UD7>();
+  vector<DP> dagens(agens.begin(), agens.end());
+  auto[BA, SA, DeltaA] =
+      random_shreier_sims<OrbT>(dagens.begin(), dagens.end(), 40, 0, 2024);
+  simple_check(group_order(DeltaA.begin(), DeltaA.end()) == 2520);
+
+  // every generator and its products are members
+  for (auto &&g : dagens)
+    for (auto &&h : dagens) {
+      auto res = strip(product(g, h), BA.begin(), BA.end(), DeltaA.begin());
+      simple_check(res.first == g.id() && res.second == BA.end());
+    }
+  DP odd{{1, 2}};
+  auto res = strip(odd, BA.begin(), BA.end(), DeltaA.begin());
+  simple_check(res.first != odd.id() || res.second != BA.end());
+
+  // 21! does not fit in 64 bits
+  using UD21 = UnsignedDomain<1, 21>;
+  auto bgens = min_symmetric_gens<UD21>();
+  vector<DensePermutation<UD21>> dbgens(bgens.begin(), bgens.end());
+  auto[BB, SB, DeltaB] = shreier_sims<OrbT>(dbgens.begin(), dbgens.end());
+  bool thrown = false;
+  try {
+    group_order(DeltaB.begin(), DeltaB.end());
+  } catch (overflow_error &) {
+    thrown = true;
+  }
+  simple_check(thrown);
+  simple_check(group_order(DeltaB.begin() + 1, DeltaB.end()) ==
+               2432902008176640000ull);
+
+  return 0;
+}
+
+template <template <class...> class OrbT> int test_element_stream() {
+  cout << "Element stream tests" << endl;
+  using UD6 = UnsignedDomain<1, 6>;
+  using DP = DensePermutation<UD6>;
+
+  auto agens = alternating_gens<UD6>();
+  vector<DP> dagens(agens.begin(), agens.end());
+  auto[B, S, Delta] = shreier_sims<OrbT>(dagens.begin(), dagens.end());
+
+  set<DP> allalt;
+  all_elements(dagens.begin(), dagens.end(),
+               std::inserter(allalt, allalt.end()));
+
+  // every element exactly once, in rank order
+  ElementRank rk(B.begin(), B.end(), Delta.begin());
+  simple_check(rk.order() == 360);
+  set<DP> streamed;
+  size_t n = 0;
+  for (ElementStream s(Delta.begin(), Delta.end()); !s.done(); ++s, ++n) {
+    streamed.insert(*s);
+    simple_check(rk.rank(*s) == n);
+    simple_check(rk.unrank(n) == *s);
+  }
+  simple_check(n == 360);
+  simple_check(streamed == allalt);
+
+  // odd permutation is not in Alt(6)
+  DP odd{{1, 2}};
+  simple_check(!rk.rank(odd).has_value());
+
+  bool thrown = false;
+  try {
+    rk.unrank(360);
+  } catch (std::invalid_argument &) {
+    thrown = true;
+  }
+  simple_check(thrown);
+
+  // visitor may stop enumeration
+  size_t nvisited =
+      for_each_element(Delta.begin(), Delta.end(), [](const DP &) {});
+  simple_check(nvisited == 360);
+  size_t nids = 0;
+  nvisited = for_each_element(Delta.begin(), Delta.end(), [&](const DP &g) {
+    nids += (g == g.id());
+    return g.apply(1) == 1;
+  });
+  simple_check(nvisited >= 1 && nvisited < 360 && nids <= 1);
+
+  // trivial group has only id
+  vector<OrbT<UD6, DP>> nolevels;
+  ElementStream e(nolevels.begin(), nolevels.end());
+  simple_check(!e.done() && *e == DP{});
+  ++e;
+  simple_check(e.done());
+
+  return 0;
+}
+
+template <template <class...> class OrbT> int test_backtrack() {
+  cout << "Backtrack tests" << endl;
+  using UD6 = UnsignedDomain<1, 6>;
+  using P = Permutation<UD6>;
+
+  // compare with brute force over all elements of G
+  auto check = [&](const gens_t<UD6> &gens, const vector<size_t> &col,
+                   size_t refsz) {
+    auto preserves = [&col](const P &g) {
+      for (size_t x = 0; x != col.size(); ++x)
+        if (col[g.apply(UD6(x + 1)) - 1] != col[x])
+          return false;
+      return true;
+    };
+    vector<P> elts;
+    all_elements(gens.begin(), gens.end(), back_inserter(elts));
+    size_t brute = count_if(elts.begin(), elts.end(), preserves);
+    simple_check(brute == refsz);
+
+    auto[B, S, Delta] =
+        coloring_stabilizer<OrbT>(gens.begin(), gens.end(), col);
+    simple_check(group_order(Delta.begin(), Delta.end()) == refsz);
+    for (auto &&lvl : S)
+      for (auto &&s : lvl)
+        simple_check(preserves(s));
+    for (auto &&g : elts) {
+      auto res = strip(g, B.begin(), B.end(), Delta.begin());
+      simple_check(preserves(g) ==
+                   (res.first == g.id() && res.second == B.end()));
+    }
+  };
+
+  auto sgens = symmetric_gens<UD6>();
+  auto agens = alternating_gens<UD6>();
+  gens_t<UD6> dgens{{{1, 2, 3, 4, 5, 6}}, {{2, 6}, {3, 5}}};
+
+  // Sym(3) x Sym(3), its even part, and Sym(2) wr Sym(3)
+  check(sgens, {1, 1, 1, 0, 0, 0}, 36);
+  check(agens, {1, 1, 1, 0, 0, 0}, 18);
+  check(sgens, {0, 0, 1, 1, 2, 2}, 8);
+  check(sgens, {0, 1, 2, 3, 4, 5}, 1);
+  check(sgens, {0, 0, 0, 0, 0, 0}, 720);
+
+  // hexagon: setwise stabilizer of opposite vertices
+  check(dgens, {1, 0, 0, 1, 0, 0}, 4);
+  check(dgens, {1, 1, 0, 0, 0, 0}, 2);
+
+  vector<UD6> pts{1, 2, 3};
+  auto[B, S, Delta] =
+      setwise_stabilizer<OrbT>(sgens.begin(), sgens.end(), pts.begin(),
+                               pts.end());
+  simple_check(group_order(Delta.begin(), Delta.end()) == 36);
+
+  // trivial result has no levels
+  vector<UD6> single{1};
+  auto[TB, TS, TDelta] = setwise_stabilizer<OrbT>(
+      dgens.begin(), dgens.end(), single.begin(), single.end());
+  simple_check(group_order(TDelta.begin(), TDelta.end()) == 2 &&
+               TB.size() == 1);
+  vector<size_t> rigid{0, 1, 2, 3, 4, 5};
+  auto[RB, RS, RDelta] =
+      coloring_stabilizer<OrbT>(dgens.begin(), dgens.end(), rigid);
+  simple_check(RB.empty() && RS.empty() && RDelta.empty());
+
+  bool thrown = false;
+  try {
+    vector<size_t> shortcol{0, 1};
+    coloring_stabilizer<OrbT>(sgens.begin(), sgens.end(), shortcol);
+  } catch (std::invalid_argument &) {
+    thrown = true;
+  }
+  simple_check(thrown);
+
+  return 0;
+}
+
+template <template <class...> class OrbT> int test_centralizer() {
+  cout << "Centralizer tests" << endl;
+  using UD6 = UnsignedDomain<1, 6>;
+  using P = Permutation<UD6>;
+
+  auto sgens = symmetric_gens<UD6>();
+  auto agens = alternating_gens<UD6>();
+  gens_t<UD6> dgens{{{1, 2, 3, 4, 5, 6}}, {{2, 6}, {3, 5}}};
+
+  auto conj = [](const P &g, const P &x) {
+    return product(product(invert(x), g), x);
+  };
+
+  // centralizers and conjugacy against brute force
+  for (auto *gens : {&sgens, &agens, &dgens}) {
+    vector<P> elts;
+    all_elements(gens->begin(), gens->end(), back_inserter(elts));
+    for (size_t i = 0; i < elts.size(); i += 17) {
+      const P &g = elts[i];
+      auto[B, S, Delta] = centralizer<OrbT>(gens->begin(), gens->end(), g);
+      size_t brute = 0;
+      for (auto &&x : elts) {
+        bool commutes = (product(g, x) == product(x, g));
+        brute += commutes;
+        auto res = strip(x, B.begin(), B.end(), Delta.begin());
+        simple_check(commutes ==
+                     (res.first == x.id() && res.second == B.end()));
+      }
+      simple_check(group_order(Delta.begin(), Delta.end()) == brute);
+
+      const P &h = elts[(i * 7 + 3) % elts.size()];
+      bool brutec = any_of(elts.begin(), elts.end(),
+                           [&](const P &x) { return conj(g, x) == h; });
+      auto x = is_conjugate<OrbT>(gens->begin(), gens->end(), g, h);
+      simple_check(x.has_value() == brutec);
+      if (x)
+        simple_check(conj(g, *x) == h &&
+                     find(elts.begin(), elts.end(), *x) != elts.end());
+    }
+  }
+
+  // 5-cycles split into two classes in Alt(5)
+  using UD5 = UnsignedDomain<1, 5>;
+  auto a5gens = alternating_gens<UD5>();
+  auto s5gens = symmetric_gens<UD5>();
+  Permutation<UD5> c1{{1, 2, 3, 4, 5}}, c2{{1, 2, 3, 5, 4}};
+  simple_check(!is_conjugate<OrbT>(a5gens.begin(), a5gens.end(), c1, c2));
+  auto x5 = is_conjugate<OrbT>(s5gens.begin(), s5gens.end(), c1, c2);
+  simple_check(x5 && product(product(invert(*x5), c1), *x5) == c2);
+  simple_check(!is_conjugate<OrbT>(s5gens.begin(), s5gens.end(), c1,
+                                   Permutation<UD5>{{1, 2}}));
+
+  // normalizers in Sym(4): Klein group is normal, 4-cycle gives D8
+  using UD4 = UnsignedDomain<1, 4>;
+  using P4 = Permutation<UD4>;
+  auto s4gens = symmetric_gens<UD4>();
+  vector<P4> s4elts;
+  all_elements(s4gens.begin(), s4gens.end(), back_inserter(s4elts));
+  vector<vector<P4>> hs = {{{{1, 2}, {3, 4}}, {{1, 3}, {2, 4}}},
+                           {{{1, 2, 3, 4}}},
+                           {{{1, 2}}},
+                           {{{1, 2, 3}}},
+                           {P4{}}};
+  vector<size_t> nref = {24, 8, 4, 6, 24};
+  for (size_t i = 0; i != hs.size(); ++i) {
+    auto[B, S, Delta] = normalizer<OrbT>(s4gens.begin(), s4gens.end(),
+                                         hs[i].begin(), hs[i].end());
+    simple_check(group_order(Delta.begin(), Delta.end()) == nref[i]);
+    set<P4> hset;
+    all_elements(hs[i].begin(), hs[i].end(), std::inserter(hset, hset.end()));
+    for (auto &&x : s4elts) {
+      bool normalizes = all_of(hset.begin(), hset.end(), [&](const P4 &s) {
+        return hset.count(product(product(invert(x), s), x)) == 1;
+      });
+      auto res = strip(x, B.begin(), B.end(), Delta.begin());
+      simple_check(normalizes ==
+                   (res.first == x.id() && res.second == B.end()));
+    }
+  }
+
+  return 0;
+}
+
 int main() {
   try {
     test_primitive_blocks();
@@ -197,6 +875,62 @@ int main() {
 
     test_strip<ShreierOrbit>();
     test_shreier_sims<ShreierOrbit>();
+
+    test_strip<FlatDirectOrbit>();
+    test_shreier_sims<FlatDirectOrbit>();
+
+    test_strip<FlatShreierOrbit>();
+    test_shreier_sims<FlatShreierOrbit>();
+
+    test_strip<ShallowShreierOrbit>();
+    test_shreier_sims<ShallowShreierOrbit>();
+
+    test_strip<CachedShreierOrbit>();
+    test_shreier_sims<CachedShreierOrbit>();
+
+    test_dense_shreier_sims<DirectOrbit, DensePermutation>();
+    test_dense_shreier_sims<ShreierOrbit, DensePermutation>();
+    test_dense_shreier_sims<DirectOrbit, PackedPermutation>();
+    test_dense_shreier_sims<ShreierOrbit, PackedPermutation>();
+    test_dense_shreier_sims<FlatDirectOrbit, DensePermutation>();
+    test_dense_shreier_sims<FlatShreierOrbit, DensePermutation>();
+    test_dense_shreier_sims<FlatShreierOrbit, PackedPermutation>();
+    test_dense_shreier_sims<ShallowShreierOrbit, DensePermutation>();
+    test_dense_shreier_sims<CachedShreierOrbit, DensePermutation>();
+
+    test_runtime_domain<DirectOrbit>();
+    test_runtime_domain<ShreierOrbit>();
+    test_runtime_domain<FlatShreierOrbit>();
+
+    test_incremental_bsgs<DirectOrbit>();
+    test_incremental_bsgs<FlatShreierOrbit>();
+    test_incremental_bsgs<ShallowShreierOrbit>();
+
+    test_base_change<DirectOrbit>();
+    test_base_change<FlatShreierOrbit>();
+    test_base_change<ShallowShreierOrbit>();
+    test_base_change<CachedShreierOrbit>();
+
+    test_stab_chain<DirectOrbit>();
+    test_stab_chain<FlatShreierOrbit>();
+
+    test_product_replacement();
+
+    test_random_shreier_sims<FlatShreierOrbit>();
+    test_random_shreier_sims<ShallowShreierOrbit>();
+    test_random_shreier_sims<DirectOrbit>();
+
+    test_element_stream<DirectOrbit>();
+    test_element_stream<ShreierOrbit>();
+    test_element_stream<FlatShreierOrbit>();
+
+    test_backtrack<DirectOrbit>();
+    test_backtrack<FlatShreierOrbit>();
+    test_backtrack<ShallowShreierOrbit>();
+
+    test_centralizer<DirectOrbit>();
+    test_centralizer<FlatShreierOrbit>();
+    test_centralizer<ShallowShreierOrbit>();
   } catch (exception &e) {
     cout << "Failed: " << e.what() << endl;
     exit(-1);
@@ -7,6 +7,21 @@
 //  Integral domain encodes integral diapasone [A, B]
 //  Say Idom<unsigned, 1, 7> encodes range [1, 2, 3, 4, 5, 6, 7]
 //
+//  Runtime domain Rdom<T> has the same interface, but its bounds are static
+//  variables, set by set_bounds at runtime. So degree need not be known at
+//  compile time, say it is read from input.
+//
+//  Limitation: degree is not carried by objects, it is one process-wide
+//  value per Tag. Groups of different degrees can not live at the same time
+//  over one Rdom<T, Tag>, every degree needs its own compile-time Tag, just
+//  like Idom needs its own bounds.
+//
+//  Hard precondition: bounds are shared by all values and all threads using
+//  Rdom<T, Tag>, and are not synchronized. They shall be set once, before any
+//  value, permutation or thread using the domain exists. Changing them later
+//  would silently break live permutations, so set_bounds refuses to change
+//  bounds once set (setting the same bounds again is ok)
+//
 //------------------------------------------------------------------------------
 
 #ifndef IDOM_GUARD_
@@ -36,9 +51,42 @@ template <typename T, T start_, T fin_> struct Idom {
   static constexpr T fin = fin_;
 };
 
+template <typename T, typename Tag = void> struct Rdom {
+  T val_;
+  Rdom(T val = start) : val_(val) {
+#ifndef NDEBUG
+    if (val > fin)
+      throw std::out_of_range(string("value too big for domain: ") +
+                              to_string(val));
+    if (val < start)
+      throw std::out_of_range("value too small for domain");
+#endif
+  }
+  operator T() const { return val_; }
+
+  static void set_bounds(T start_, T fin_) {
+    if (bounded && (start_ != start || fin_ != fin))
+      throw std::logic_error("domain bounds are already set");
+    if (fin_ < start_)
+      throw std::invalid_argument("domain shall be non-empty");
+    start = start_;
+    fin = fin_;
+    bounded = true;
+  }
+
+  using type = T;
+  static constexpr bool runtime = true;
+  static inline T start = 0;
+  static inline T fin = 0;
+  static inline bool bounded = false;
+};
+
 template <unsigned start_, unsigned fin_>
 using UnsignedDomain = Idom<unsigned, start_, fin_>;
 
+template <typename Tag = void>
+using UnsignedRuntimeDomain = Rdom<unsigned, Tag>;
+
 template <char start_, char fin_> using CharDomain = Idom<char, start_, fin_>;
 
 #endif
@@ -13,26 +13,92 @@
 // 4. size: size of orbit
 // 5. dump: pretty-print orbit
 // 6. extend_orbit: extends orbit (takes extended generators set)
+// 7. sift: h = h * ubeta(b)^-1 in place
+// 8. conjugate(c): orbit of a^c over G^c = c^-1 * G * c, made by relabeling
+//    points and stored elements, without orbit calculation. All orbits here
+//    have it, conjugate_chain rebuilds orbits of other types
+//
+// Orbits with shreier vector also give ubeta as word over their internal
+// generators table (uword), without multiplying anything, trace point through
+// such word and sift by multiplying h by inverse generators along the path,
+// never materializing ubeta itself
+//
+// Every orbit is parametrized by domain T and by permutation type Perm, which
+// defaults to loop-form Permutation<T>. Any type with the same interface
+// (say DensePermutation<T>) may be used instead
+//
+// FlatDirectOrbit and FlatShreierOrbit implement the same concept over flat
+// arrays: orbit points are kept in BFS queue and membership is checked in
+// table indexed by domain point. Extending orbit by new generator applies
+// it to old points only, and all generators to new points only.
+// Iteration order is BFS order, not sorted one
+//
+// ShallowShreierOrbit keeps Schreier tree not over generators, but over cube
+// labels t[0] .. t[k-1] and their inverses, chosen such that orbit is
+// b^(C * C^-1), where C is cube {t[k-1]^ek * ... * t[0]^e0, e = 0 or 1}.
+// New label t is put on the left, C' = C + t * C, and taken with b^t outside
+// of b^(C * C^-1) (Seress 4.4 condition). So b^(t * C) does not meet b^C and
+// t * C does not meet C. Hence cube doubles as set of group elements,
+// k <= log2 |G|, and b^C grows with every label, k <= |orbit| - 1. Tree
+// depth (number of multiplications in ubeta) is at most 2k.
+// Note b^C itself need not double: |b^(t * C)| = |(b^t)^C| may be less than
+// |b^C|, so log2 |orbit| is not a hard bound for k, though for small orbits
+// of big groups k is still bounded by orbit, not by group.
+// ref: Seress, Permutation Group Algorithms, 4.4 (deterministic version)
+//
+// CachedShreierOrbit is FlatShreierOrbit with LRU cache of inverted
+// transversal elements, bounded in bytes. Every entry is charged by its
+// actual size, Perm::bytes(), so loop-form entries of different shape cost
+// differently. Unwinding stops at first cached ancestor, and its result is
+// cached in turn. Root and its children are never cached, one
+// multiplication is cheaper. Budget is per orbit, so stabilizer chain over
+// such orbits takes up to (number of levels) * budget. It is taken at orbit
+// construction from CachedShreierOrbit<T, Perm>::set_default_budget or
+// changed later by set_budget. Zero budget means plain FlatShreierOrbit
 //
 //------------------------------------------------------------------------------
 
 #ifndef ORBITS_GUARD__
 #define ORBITS_GUARD__
 
+#include "flathash.hpp"
 #include "groupgens.hpp"
+#include "permdense.hpp"
 #include "perms.hpp"
 
+using permutations::DensePermutation;
+using permutations::FlatMap;
+using permutations::FlatSet;
 using permutations::Permutation;
 
 namespace orbits {
 
+// transversal element as word: ubeta = gen[w[0]] * gen[w[1]] * ...
+using word_t = vector<size_t>;
+
+// table indexed by domain points, relabeled by c: res[x^c] = tbl[x]
+template <typename T, typename Perm, typename V>
+vector<V> conjugate_table(const vector<V> &tbl, const Perm &c) {
+  vector<V> res(tbl.size());
+  for (size_t x = 0; x != tbl.size(); ++x)
+    res[c.apply(static_cast<T>(T::start + x)) - T::start] = tbl[x];
+  return res;
+}
+
+// g = c^-1 * g * c in place, cinv is c^-1
+template <typename Perm>
+void conjugate_perm(Perm &g, const Perm &c, const Perm &cinv) {
+  g.lmul(cinv);
+  g.rmul(c);
+}
+
 // orbit, storing all generators along with elements
-template <typename T> class DirectOrbit {
-  using iter_t = typename map<T, Permutation<T>>::iterator;
+template <typename T, typename Perm = Permutation<T>> class DirectOrbit {
+  using iter_t = typename map<T, Perm>::iterator;
 
   T elt_;
-  map<T, Permutation<T>> orb_;
-  set<Permutation<T>> gens_;
+  map<T, Perm> orb_;
+  FlatSet<Perm> gens_;
 
   struct PartialIt {
     iter_t cur_;
@@ -62,7 +128,7 @@ public:
   }
 
   void extend_orbit();
-  void extend_orbit(const Permutation<T> &newgen) {
+  void extend_orbit(const Perm &newgen) {
     auto oldsize = gens_.size();
     gens_.insert(newgen);
     if (oldsize != gens_.size())
@@ -72,14 +138,33 @@ public:
   auto end() { return PartialIt{orb_.end()}; }
   auto size() const { return orb_.size(); }
   bool contains(const T &x) const { return orb_.find(x) != orb_.end(); }
-  auto ubeta(T x) { return orb_[x]; }
+  auto ubeta(T x) const { return orb_.at(x); }
+  void sift(Perm &h, T x) const { h.rmul(invert(orb_.at(x))); }
+  void conjugate(const Perm &c);
   ostream &dump(ostream &os);
 };
 
-template <typename T> void DirectOrbit<T>::extend_orbit() {
-  map<T, Permutation<T>> next = orb_;
+template <typename T, typename Perm>
+void DirectOrbit<T, Perm>::conjugate(const Perm &c) {
+  auto cinv = invert(c);
+  map<T, Perm> orb;
+  for (auto && [ elem, u ] : orb_) {
+    Perm v = u;
+    conjugate_perm(v, c, cinv);
+    orb.emplace(c.apply(elem), move(v));
+  }
+  vector<Perm> gens(gens_.begin(), gens_.end());
+  for (auto &g : gens)
+    conjugate_perm(g, c, cinv);
+  elt_ = c.apply(elt_);
+  orb_.swap(orb);
+  gens_ = FlatSet<Perm>(gens.begin(), gens.end());
+}
+
+template <typename T, typename Perm> void DirectOrbit<T, Perm>::extend_orbit() {
+  map<T, Perm> next = orb_;
   while (!next.empty()) {
-    map<T, Permutation<T>> tmp{};
+    map<T, Perm> tmp{};
     for (auto &&gen : gens_)
       for (auto && [ elem, curgen ] : next)
         if (auto newelem = gen.apply(elem); orb_.find(newelem) == orb_.end())
@@ -89,7 +174,8 @@ template <typename T> void DirectOrbit<T>::extend_orbit() {
   }
 }
 
-template <typename T> ostream &DirectOrbit<T>::dump(ostream &os) {
+template <typename T, typename Perm>
+ostream &DirectOrbit<T, Perm>::dump(ostream &os) {
   os << "[ ";
   for (auto &&oit : orb_)
     os << oit.first << ": " << oit.second << " ";
@@ -97,7 +183,8 @@ template <typename T> ostream &DirectOrbit<T>::dump(ostream &os) {
   return os;
 }
 
-template <typename T> ostream &operator<<(ostream &os, DirectOrbit<T> d) {
+template <typename T, typename Perm>
+ostream &operator<<(ostream &os, DirectOrbit<T, Perm> d) {
   return d.dump(os);
 }
 
@@ -107,14 +194,14 @@ template <typename T> ostream &operator<<(ostream &os, DirectOrbit<T> d) {
 // v[newelem] = i, where i is (#newgen + 1)
 
 // orbit, internally storing shreier vectors
-template <typename T> class ShreierOrbit {
+template <typename T, typename Perm = Permutation<T>> class ShreierOrbit {
   T elt_;
   set<T> orb_;
   vector<int> v_;
-  vector<Permutation<T>> gens_;
+  vector<Perm> gens_;
 
   // also storing inverse generators to speed up critical ubeta section
-  vector<Permutation<T>> invgens_;
+  vector<Perm> invgens_;
 
 public:
   using type = T;
@@ -131,8 +218,7 @@ public:
   }
 
   void extend_orbit();
-  void extend_orbit(const Permutation<T> &newgen) {
-    auto oldsize = gens_.size();
+  void extend_orbit(const Perm &newgen) {
     if (find(gens_.begin(), gens_.end(), newgen) == gens_.end()) {
       gens_.push_back(newgen);
       invgens_.push_back(invert(newgen));
@@ -144,10 +230,34 @@ public:
   bool contains(const T &x) { return orb_.find(x) != orb_.end(); }
   auto size() const { return orb_.size(); }
   auto ubeta(T orbelem);
+  word_t uword(T orbelem) const;
+  T trace(T x, const word_t &w) const {
+    for (auto k : w)
+      x = gens_[k].apply(x);
+    return x;
+  }
+  void sift(Perm &h, T orbelem) const;
+  void conjugate(const Perm &c);
   ostream &dump(ostream &os);
 };
 
-template <typename T> void ShreierOrbit<T>::extend_orbit() {
+template <typename T, typename Perm>
+void ShreierOrbit<T, Perm>::conjugate(const Perm &c) {
+  auto cinv = invert(c);
+  set<T> orb;
+  for (auto x : orb_)
+    orb.insert(c.apply(x));
+  orb_.swap(orb);
+  v_ = conjugate_table<T>(v_, c);
+  for (size_t k = 0; k != gens_.size(); ++k) {
+    conjugate_perm(gens_[k], c, cinv);
+    conjugate_perm(invgens_[k], c, cinv);
+  }
+  elt_ = c.apply(elt_);
+}
+
+template <typename T, typename Perm>
+void ShreierOrbit<T, Perm>::extend_orbit() {
   set<T> next = orb_;
   while (!next.empty()) {
     set<T> tmp;
@@ -163,10 +273,11 @@ template <typename T> void ShreierOrbit<T>::extend_orbit() {
   }
 }
 
-template <typename T> auto ShreierOrbit<T>::ubeta(T orbelem) {
+template <typename T, typename Perm>
+auto ShreierOrbit<T, Perm>::ubeta(T orbelem) {
   assert(orbelem >= T::start);
   assert(orbelem <= T::fin);
-  Permutation<T> res{};
+  Perm res{};
   auto k = v_[orbelem - T::start];
   if (k == 0)
     return res;
@@ -184,7 +295,27 @@ template <typename T> auto ShreierOrbit<T>::ubeta(T orbelem) {
   return res;
 }
 
-template <typename T> ostream &ShreierOrbit<T>::dump(ostream &os) {
+template <typename T, typename Perm>
+word_t ShreierOrbit<T, Perm>::uword(T orbelem) const {
+  word_t w;
+  for (auto k = v_[orbelem - T::start]; k > 0; k = v_[orbelem - T::start]) {
+    w.push_back(k - 1);
+    orbelem = invgens_[k - 1].apply(orbelem);
+  }
+  reverse(w.begin(), w.end());
+  return w;
+}
+
+template <typename T, typename Perm>
+void ShreierOrbit<T, Perm>::sift(Perm &h, T orbelem) const {
+  for (auto k = v_[orbelem - T::start]; k > 0; k = v_[orbelem - T::start]) {
+    h.rmul(invgens_[k - 1]);
+    orbelem = invgens_[k - 1].apply(orbelem);
+  }
+}
+
+template <typename T, typename Perm>
+ostream &ShreierOrbit<T, Perm>::dump(ostream &os) {
   os << "[ ";
   for (auto &&oit : orb_)
     os << oit << ": " << ubeta(oit) << " ";
@@ -192,7 +323,626 @@ template <typename T> ostream &ShreierOrbit<T>::dump(ostream &os) {
   return os;
 }
 
-template <typename T> ostream &operator<<(ostream &os, ShreierOrbit<T> d) {
+template <typename T, typename Perm>
+ostream &operator<<(ostream &os, ShreierOrbit<T, Perm> d) {
+  return d.dump(os);
+}
+
+// orbit, storing all generators along with elements, flat storage
+template <typename T, typename Perm = Permutation<T>> class FlatDirectOrbit {
+  T elt_;
+  FlatSet<Perm> gens_;
+
+  // orbit points in BFS order and corresponding ubeta
+  vector<T> points_;
+  vector<Perm> trans_;
+
+  // pos_[x - T::start] is number of x in points_ plus 1, 0 if not in orbit
+  vector<uint32_t> pos_;
+
+public:
+  using type = T;
+
+  template <typename GenIter>
+  FlatDirectOrbit(T num, GenIter gensbeg, GenIter gensend)
+      : elt_(num), pos_(T::fin - T::start + 1, 0) {
+    add_point(num, Perm{});
+    gens_.insert(gensbeg, gensend);
+    extend_from(0, 0);
+  }
+
+  // all generators over all points, nothing to do if set is not changed
+  void extend_orbit() { extend_from(0, 0); }
+  void extend_orbit(const Perm &newgen) {
+    auto oldsize = gens_.size();
+    gens_.insert(newgen);
+    if (oldsize != gens_.size())
+      extend_from(points_.size(), oldsize);
+  }
+  auto begin() const { return points_.cbegin(); }
+  auto end() const { return points_.cend(); }
+  auto size() const { return points_.size(); }
+  bool contains(const T &x) const { return pos_[x - T::start] != 0; }
+  Perm ubeta(T x) const {
+    auto pos = pos_[x - T::start];
+    return (pos == 0) ? Perm{} : trans_[pos - 1];
+  }
+  void sift(Perm &h, T x) const {
+    if (auto pos = pos_[x - T::start]; pos != 0)
+      h.rmul(invert(trans_[pos - 1]));
+  }
+  void conjugate(const Perm &c);
+  ostream &dump(ostream &os) const;
+
+private:
+  void add_point(T x, Perm u) {
+    points_.push_back(x);
+    trans_.push_back(move(u));
+    pos_[x - T::start] = points_.size();
+  }
+
+  // points before oldsize were already processed by generators before firstgen
+  void extend_from(size_t oldsize, size_t firstgen);
+};
+
+template <typename T, typename Perm>
+void FlatDirectOrbit<T, Perm>::extend_from(size_t oldsize, size_t firstgen) {
+  auto &gens = gens_.keys();
+  for (size_t i = 0; i != points_.size(); ++i)
+    for (size_t g = (i < oldsize) ? firstgen : 0; g < gens.size(); ++g)
+      if (auto newelem = gens[g].apply(points_[i]); !contains(newelem))
+        add_point(newelem, product(trans_[i], gens[g]));
+}
+
+template <typename T, typename Perm>
+void FlatDirectOrbit<T, Perm>::conjugate(const Perm &c) {
+  auto cinv = invert(c);
+  for (size_t i = 0; i != points_.size(); ++i) {
+    points_[i] = c.apply(points_[i]);
+    conjugate_perm(trans_[i], c, cinv);
+  }
+  pos_ = conjugate_table<T>(pos_, c);
+
+  // same order of generators, so extend_from still works
+  vector<Perm> gens = gens_.keys();
+  for (auto &g : gens)
+    conjugate_perm(g, c, cinv);
+  gens_ = FlatSet<Perm>(gens.begin(), gens.end());
+  elt_ = c.apply(elt_);
+}
+
+template <typename T, typename Perm>
+ostream &FlatDirectOrbit<T, Perm>::dump(ostream &os) const {
+  os << "[ ";
+  for (size_t i = 0; i != points_.size(); ++i)
+    os << points_[i] << ": " << trans_[i] << " ";
+  os << "]";
+  return os;
+}
+
+template <typename T, typename Perm>
+ostream &operator<<(ostream &os, const FlatDirectOrbit<T, Perm> &d) {
+  return d.dump(os);
+}
+
+// orbit, internally storing shreier vectors, flat storage
+// shreier vector itself is membership table
+template <typename T, typename Perm = Permutation<T>> class FlatShreierOrbit {
+  T elt_;
+  vector<T> points_;
+  vector<int> v_;
+  vector<Perm> gens_;
+  vector<Perm> invgens_;
+
+public:
+  using type = T;
+
+  template <typename GenIter>
+  FlatShreierOrbit(T num, GenIter gensbeg, GenIter gensend)
+      : elt_(num), v_(T::fin - T::start + 1, 0) {
+    gens_.assign(gensbeg, gensend);
+    transform(gens_.begin(), gens_.end(), back_inserter(invgens_),
+              [](const Perm &x) { return invert(x); });
+    points_.push_back(num);
+    v_[num - T::start] = -1;
+    extend_from(0, 0);
+  }
+
+  void extend_orbit() { extend_from(0, 0); }
+  void extend_orbit(const Perm &newgen) {
+    if (find(gens_.begin(), gens_.end(), newgen) == gens_.end()) {
+      gens_.push_back(newgen);
+      invgens_.push_back(invert(newgen));
+      extend_from(points_.size(), gens_.size() - 1);
+    }
+  }
+  auto begin() const { return points_.cbegin(); }
+  auto end() const { return points_.cend(); }
+  bool contains(const T &x) const { return v_[x - T::start] != 0; }
+  auto size() const { return points_.size(); }
+  Perm ubeta(T orbelem) const;
+  word_t uword(T orbelem) const;
+  T trace(T x, const word_t &w) const {
+    for (auto k : w)
+      x = gens_[k].apply(x);
+    return x;
+  }
+  void sift(Perm &h, T orbelem) const;
+  void conjugate(const Perm &c);
+  ostream &dump(ostream &os) const;
+
+protected:
+  // shreier vector entry and inverse generators, for derived orbits
+  int sv(T x) const { return v_[x - T::start]; }
+  const Perm &invgen(size_t k) const { return invgens_[k]; }
+
+private:
+  void extend_from(size_t oldsize, size_t firstgen);
+};
+
+template <typename T, typename Perm>
+void FlatShreierOrbit<T, Perm>::extend_from(size_t oldsize, size_t firstgen) {
+  for (size_t i = 0; i != points_.size(); ++i)
+    for (size_t g = (i < oldsize) ? firstgen : 0; g < gens_.size(); ++g)
+      if (auto newelem = gens_[g].apply(points_[i]); !contains(newelem)) {
+        v_[newelem - T::start] = g + 1;
+        points_.push_back(newelem);
+      }
+}
+
+template <typename T, typename Perm>
+Perm FlatShreierOrbit<T, Perm>::ubeta(T orbelem) const {
+  assert(orbelem >= T::start);
+  assert(orbelem <= T::fin);
+  Perm res{};
+  auto k = v_[orbelem - T::start];
+  if (k == 0)
+    return res;
+
+  // parent of every point is added to queue before it, so no loops here
+  while (k != -1) {
+    res.lmul(gens_[k - 1]);
+    orbelem = invgens_[k - 1].apply(orbelem);
+    k = v_[orbelem - T::start];
+    assert(k != 0);
+  }
+  return res;
+}
+
+template <typename T, typename Perm>
+word_t FlatShreierOrbit<T, Perm>::uword(T orbelem) const {
+  word_t w;
+  for (auto k = v_[orbelem - T::start]; k > 0; k = v_[orbelem - T::start]) {
+    w.push_back(k - 1);
+    orbelem = invgens_[k - 1].apply(orbelem);
+  }
+  reverse(w.begin(), w.end());
+  return w;
+}
+
+template <typename T, typename Perm>
+void FlatShreierOrbit<T, Perm>::sift(Perm &h, T orbelem) const {
+  for (auto k = v_[orbelem - T::start]; k > 0; k = v_[orbelem - T::start]) {
+    h.rmul(invgens_[k - 1]);
+    orbelem = invgens_[k - 1].apply(orbelem);
+  }
+}
+
+template <typename T, typename Perm>
+void FlatShreierOrbit<T, Perm>::conjugate(const Perm &c) {
+  auto cinv = invert(c);
+  for (auto &x : points_)
+    x = c.apply(x);
+  v_ = conjugate_table<T>(v_, c);
+  for (size_t k = 0; k != gens_.size(); ++k) {
+    conjugate_perm(gens_[k], c, cinv);
+    conjugate_perm(invgens_[k], c, cinv);
+  }
+  elt_ = c.apply(elt_);
+}
+
+template <typename T, typename Perm>
+ostream &FlatShreierOrbit<T, Perm>::dump(ostream &os) const {
+  os << "[ ";
+  for (auto &&oit : points_)
+    os << oit << ": " << ubeta(oit) << " ";
+  os << "]";
+  return os;
+}
+
+template <typename T, typename Perm>
+ostream &operator<<(ostream &os, const FlatShreierOrbit<T, Perm> &d) {
+  return d.dump(os);
+}
+
+// orbit, storing shreier vector and LRU cache of inverted transversals
+template <typename T, typename Perm = Permutation<T>>
+class CachedShreierOrbit : public FlatShreierOrbit<T, Perm> {
+  using Base = FlatShreierOrbit<T, Perm>;
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  struct Entry {
+    T pt;
+    Perm uinv;
+    size_t prev, next;
+  };
+
+  // entries form intrusive list from most (head_) to least (tail_) recent
+  // evicted entries are kept in free_ for reuse
+  vector<Entry> entries_;
+  vector<size_t> free_;
+  size_t head_ = npos, tail_ = npos;
+
+  // slot_[x - T::start] is entry for x or npos
+  vector<size_t> slot_;
+  size_t budget_;
+  size_t used_ = 0;
+
+  // result storage when nothing can be cached
+  Perm scratch_;
+
+  static inline std::atomic<size_t> default_budget_ = size_t(64) << 20;
+
+public:
+  template <typename GenIter>
+  CachedShreierOrbit(T num, GenIter gensbeg, GenIter gensend)
+      : Base(num, gensbeg, gensend), slot_(T::fin - T::start + 1, npos),
+        budget_(default_budget_.load(std::memory_order_relaxed)) {}
+
+  // budget in bytes for every orbit, constructed after this call
+  static void set_default_budget(size_t bytes) {
+    default_budget_.store(bytes, std::memory_order_relaxed);
+  }
+
+  // change budget for this orbit, dropping cache
+  void set_budget(size_t bytes);
+
+  // size of cache entry, keeping given inverted transversal
+  static size_t entry_bytes(const Perm &uinv) {
+    return sizeof(Entry) - sizeof(Perm) + uinv.bytes();
+  }
+
+  size_t cached() const { return entries_.size() - free_.size(); }
+
+  // bytes taken by cache entries, never more than budget
+  size_t used_bytes() const { return used_; }
+
+  // hides non-caching versions of base orbit
+  Perm ubeta(T orbelem) {
+    if (shallow(orbelem))
+      return Base::ubeta(orbelem);
+    return invert(uinv(orbelem));
+  }
+  void sift(Perm &h, T orbelem) {
+    if (shallow(orbelem))
+      Base::sift(h, orbelem);
+    else
+      h.rmul(uinv(orbelem));
+  }
+
+  // relabels base orbit, cache is dropped
+  void conjugate(const Perm &c) {
+    Base::conjugate(c);
+    set_budget(budget_);
+  }
+
+private:
+  // outside of orbit, root or its child: unwinding is cheaper than caching
+  bool shallow(T x) const {
+    auto k = this->sv(x);
+    return (k <= 0) || (this->sv(this->invgen(k - 1).apply(x)) == -1);
+  }
+
+  // ubeta(x)^-1, reference is valid until next call
+  const Perm &uinv(T x);
+
+  void unlink(size_t idx);
+  void push_front(size_t idx);
+};
+
+template <typename T, typename Perm>
+void CachedShreierOrbit<T, Perm>::set_budget(size_t bytes) {
+  entries_.clear();
+  free_.clear();
+  head_ = tail_ = npos;
+  slot_.assign(slot_.size(), npos);
+  budget_ = bytes;
+  used_ = 0;
+}
+
+template <typename T, typename Perm>
+const Perm &CachedShreierOrbit<T, Perm>::uinv(T x) {
+  if (auto idx = slot_[x - T::start]; idx != npos) {
+    unlink(idx);
+    push_front(idx);
+    return entries_[idx].uinv;
+  }
+
+  // unwinding up to cached ancestor or root
+  // ubeta(x)^-1 = invgen[k1] * invgen[k2] * ... * ubeta(ancestor)^-1
+  Perm res{};
+  size_t anc = npos;
+  T y = x;
+  for (auto k = this->sv(y); k > 0; k = this->sv(y)) {
+    const auto &ig = this->invgen(k - 1);
+    res.rmul(ig);
+    y = ig.apply(y);
+    if ((anc = slot_[y - T::start]) != npos)
+      break;
+  }
+  if (anc != npos) {
+    res.rmul(entries_[anc].uinv);
+    unlink(anc);
+    push_front(anc);
+  }
+
+  size_t nbytes = entry_bytes(res);
+  if (nbytes > budget_) {
+    scratch_ = move(res);
+    return scratch_;
+  }
+
+  // evict least recently used until new entry fits
+  while (used_ + nbytes > budget_) {
+    size_t lru = tail_;
+    unlink(lru);
+    slot_[entries_[lru].pt - T::start] = npos;
+    used_ -= entry_bytes(entries_[lru].uinv);
+    // moving out releases its storage right now
+    auto dropped = move(entries_[lru].uinv);
+    free_.push_back(lru);
+  }
+
+  size_t idx;
+  if (free_.empty()) {
+    idx = entries_.size();
+    entries_.push_back(Entry{x, move(res), npos, npos});
+  } else {
+    idx = free_.back();
+    free_.pop_back();
+    entries_[idx].pt = x;
+    entries_[idx].uinv = move(res);
+  }
+  used_ += nbytes;
+  slot_[x - T::start] = idx;
+  push_front(idx);
+  return entries_[idx].uinv;
+}
+
+template <typename T, typename Perm>
+void CachedShreierOrbit<T, Perm>::unlink(size_t idx) {
+  auto &e = entries_[idx];
+  if (e.prev != npos)
+    entries_[e.prev].next = e.next;
+  else
+    head_ = e.next;
+  if (e.next != npos)
+    entries_[e.next].prev = e.prev;
+  else
+    tail_ = e.prev;
+  e.prev = e.next = npos;
+}
+
+template <typename T, typename Perm>
+void CachedShreierOrbit<T, Perm>::push_front(size_t idx) {
+  auto &e = entries_[idx];
+  e.prev = npos;
+  e.next = head_;
+  if (head_ != npos)
+    entries_[head_].prev = idx;
+  head_ = idx;
+  if (tail_ == npos)
+    tail_ = idx;
+}
+
+// orbit, storing shreier vector over cube labels, depth <= 2 log2 |G|
+template <typename T, typename Perm = Permutation<T>>
+class ShallowShreierOrbit {
+  T elt_;
+  vector<Perm> gens_;
+
+  // whole orbit under gens_, calculated by plain BFS
+  vector<T> orbit_;
+  vector<char> inorbit_;
+
+  // labels_[2j] = t[j], labels_[2j + 1] is its inverse
+  vector<Perm> labels_;
+
+  // b^(C * C^-1) for current labels in BFS order and shreier vector for it
+  // v[x] = i + 1 if parent of x goes to x by labels_[i], -1 for root
+  vector<T> points_;
+  vector<int> v_;
+
+public:
+  using type = T;
+
+  template <typename GenIter>
+  ShallowShreierOrbit(T num, GenIter gensbeg, GenIter gensend)
+      : elt_(num), inorbit_(T::fin - T::start + 1, 0) {
+    orbit_.push_back(num);
+    inorbit_[num - T::start] = 1;
+    gens_.assign(gensbeg, gensend);
+    extend_from(0, 0);
+    add_labels();
+  }
+
+  void extend_orbit() {
+    extend_from(0, 0);
+    add_labels();
+  }
+  void extend_orbit(const Perm &newgen) {
+    if (find(gens_.begin(), gens_.end(), newgen) == gens_.end()) {
+      gens_.push_back(newgen);
+      extend_from(orbit_.size(), gens_.size() - 1);
+      add_labels();
+    }
+  }
+  auto begin() const { return points_.cbegin(); }
+  auto end() const { return points_.cend(); }
+  bool contains(const T &x) const { return v_[x - T::start] != 0; }
+  auto size() const { return points_.size(); }
+  Perm ubeta(T orbelem) const;
+
+  // words are over labels table, where 2j is t[j] and 2j + 1 is its inverse
+  word_t uword(T orbelem) const;
+  T trace(T x, const word_t &w) const {
+    for (auto k : w)
+      x = labels_[k].apply(x);
+    return x;
+  }
+  void sift(Perm &h, T orbelem) const;
+  void conjugate(const Perm &c);
+  ostream &dump(ostream &os) const;
+
+  // number of cube labels
+  size_t nlabels() const { return labels_.size() / 2; }
+
+  // maximum number of labels on path from root
+  size_t depth() const;
+
+private:
+  void extend_from(size_t oldsize, size_t firstgen);
+
+  // recalculate points_ and v_ as b^(C * C^-1)
+  void cube_closure();
+
+  // add labels until cube closure covers whole orbit
+  void add_labels();
+};
+
+template <typename T, typename Perm>
+void ShallowShreierOrbit<T, Perm>::extend_from(size_t oldsize,
+                                               size_t firstgen) {
+  for (size_t i = 0; i != orbit_.size(); ++i)
+    for (size_t g = (i < oldsize) ? firstgen : 0; g < gens_.size(); ++g)
+      if (auto newelem = gens_[g].apply(orbit_[i]);
+          !inorbit_[newelem - T::start]) {
+        inorbit_[newelem - T::start] = 1;
+        orbit_.push_back(newelem);
+      }
+}
+
+template <typename T, typename Perm>
+void ShallowShreierOrbit<T, Perm>::cube_closure() {
+  points_.assign(1, elt_);
+  v_.assign(T::fin - T::start + 1, 0);
+  v_[elt_ - T::start] = -1;
+
+  // one pass of X = X + X^label, new points get depth + 1 at most
+  auto pass = [this](size_t lbl) {
+    for (size_t i = 0, sz = points_.size(); i != sz; ++i)
+      if (auto newelem = labels_[lbl].apply(points_[i]); !contains(newelem)) {
+        v_[newelem - T::start] = lbl + 1;
+        points_.push_back(newelem);
+      }
+  };
+
+  // C = t[k-1]^e .. t[0]^e, then C^-1 = t[0]^-e .. t[k-1]^-e
+  size_t k = nlabels();
+  for (size_t j = k; j-- > 0;)
+    pass(2 * j);
+  for (size_t j = 0; j != k; ++j)
+    pass(2 * j + 1);
+}
+
+template <typename T, typename Perm>
+void ShallowShreierOrbit<T, Perm>::add_labels() {
+  cube_closure();
+  while (points_.size() != orbit_.size()) {
+    // orbit is connected, so some generator leads out of closure
+    // if b^t is outside b^(C * C^-1), then b^(t * c) != b^c' for any c, c'
+    // in C, so b^(t * C) is disjoint from b^C and t * C from C
+    optional<Perm> t;
+    for (size_t i = 0; !t && i != points_.size(); ++i)
+      for (auto &&gen : gens_)
+        if (!contains(gen.apply(points_[i]))) {
+          t = product(ubeta(points_[i]), gen);
+          break;
+        }
+    assert(t);
+    labels_.push_back(*t);
+    labels_.push_back(invert(*t));
+    cube_closure();
+  }
+}
+
+template <typename T, typename Perm>
+Perm ShallowShreierOrbit<T, Perm>::ubeta(T orbelem) const {
+  assert(orbelem >= T::start);
+  assert(orbelem <= T::fin);
+  Perm res{};
+  auto k = v_[orbelem - T::start];
+  if (k == 0)
+    return res;
+
+  while (k != -1) {
+    res.lmul(labels_[k - 1]);
+    orbelem = labels_[(k - 1) ^ 1].apply(orbelem);
+    k = v_[orbelem - T::start];
+    assert(k != 0);
+  }
+  return res;
+}
+
+template <typename T, typename Perm>
+word_t ShallowShreierOrbit<T, Perm>::uword(T orbelem) const {
+  word_t w;
+  for (auto k = v_[orbelem - T::start]; k > 0; k = v_[orbelem - T::start]) {
+    w.push_back(k - 1);
+    orbelem = labels_[(k - 1) ^ 1].apply(orbelem);
+  }
+  reverse(w.begin(), w.end());
+  return w;
+}
+
+template <typename T, typename Perm>
+void ShallowShreierOrbit<T, Perm>::sift(Perm &h, T orbelem) const {
+  for (auto k = v_[orbelem - T::start]; k > 0; k = v_[orbelem - T::start]) {
+    const auto &inv = labels_[(k - 1) ^ 1];
+    h.rmul(inv);
+    orbelem = inv.apply(orbelem);
+  }
+}
+
+template <typename T, typename Perm>
+void ShallowShreierOrbit<T, Perm>::conjugate(const Perm &c) {
+  auto cinv = invert(c);
+  for (auto &g : gens_)
+    conjugate_perm(g, c, cinv);
+  for (auto &l : labels_)
+    conjugate_perm(l, c, cinv);
+  for (auto &x : orbit_)
+    x = c.apply(x);
+  for (auto &x : points_)
+    x = c.apply(x);
+  inorbit_ = conjugate_table<T>(inorbit_, c);
+  v_ = conjugate_table<T>(v_, c);
+  elt_ = c.apply(elt_);
+}
+
+template <typename T, typename Perm>
+size_t ShallowShreierOrbit<T, Perm>::depth() const {
+  size_t maxdepth = 0;
+  for (auto x : points_) {
+    size_t d = 0;
+    for (auto k = v_[x - T::start]; k != -1; k = v_[x - T::start], ++d)
+      x = labels_[(k - 1) ^ 1].apply(x);
+    maxdepth = max(maxdepth, d);
+  }
+  return maxdepth;
+}
+
+template <typename T, typename Perm>
+ostream &ShallowShreierOrbit<T, Perm>::dump(ostream &os) const {
+  os << "[ ";
+  for (auto &&oit : points_)
+    os << oit << ": " << ubeta(oit) << " ";
+  os << "]";
+  return os;
+}
+
+template <typename T, typename Perm>
+ostream &operator<<(ostream &os, const ShallowShreierOrbit<T, Perm> &d) {
   return d.dump(os);
 }
 
@@ -4,6 +4,7 @@
 //
 //------------------------------------------------------------------------------
 
+#include "actions.hpp"
 #include "idomain.hpp"
 #include "orbits.hpp"
 
@@ -18,12 +19,12 @@ using namespace orbits;
     }                                                                          \
   } while (0)
 
-template <template <class> class Orb, typename T, typename GenIT,
+template <template <class...> class Orb, typename T, typename GenIT,
           typename OrbIt>
 void do_test_simple_orbit(T elt, GenIT gbeg, GenIT gend, OrbIt refbeg,
                           OrbIt refend) {
   // getting orbit and checking elements
-  Orb<T> orbit(elt, gbeg, gend);
+  Orb<T, typename GenIT::value_type> orbit(elt, gbeg, gend);
   for (auto rit = refbeg; rit != refend; ++rit)
     orbit_check(orbit.contains(*rit), orbit);
 
@@ -36,10 +37,15 @@ void do_test_simple_orbit(T elt, GenIT gbeg, GenIT gend, OrbIt refbeg,
   for (auto &&beta : orbit) {
     auto u_beta = orbit.ubeta(beta);
     orbit_check(u_beta.apply(elt) == beta, orbit);
+
+    // sifting by transversal element itself gives id
+    auto h = u_beta;
+    orbit.sift(h, beta);
+    orbit_check(h == u_beta.id(), orbit);
   }
 }
 
-template <template <class> class Orb> int test_simple_orbit() {
+template <template <class...> class Orb> int test_simple_orbit() {
   cout << "Simple orbit tests" << endl;
   using UD5 = UnsignedDomain<1, 5>;
 
@@ -81,10 +87,322 @@ template <template <class> class Orb> int test_simple_orbit() {
   return 0;
 }
 
+template <template <class...> class Orb> int test_dense_orbit() {
+  cout << "Dense orbit tests" << endl;
+  using UD5 = UnsignedDomain<1, 5>;
+  using DP = DensePermutation<UD5>;
+
+  set<UD5> ref{1, 2, 3, 4, 5};
+  auto sgens = min_symmetric_gens<UD5>();
+  vector<DP> dsgens(sgens.begin(), sgens.end());
+  do_test_simple_orbit<Orb>(UD5{2}, dsgens.begin(), dsgens.end(), ref.begin(),
+                            ref.end());
+
+  set<UD5> ref2{3, 4, 5};
+  vector<DP> dgens{{{1, 2}}, {{3, 4, 5}}};
+  do_test_simple_orbit<Orb>(UD5{4}, dgens.begin(), dgens.end(), ref2.begin(),
+                            ref2.end());
+
+  return 0;
+}
+
+template <template <class...> class Orb> int test_extend_orbit() {
+  cout << "Extend orbit tests" << endl;
+  using UD6 = UnsignedDomain<1, 6>;
+  using DP = DensePermutation<UD6>;
+
+  vector<DP> gens{{{1, 2}}};
+  Orb<UD6, DP> orbit(UD6{1}, gens.begin(), gens.end());
+  orbit_check(orbit.size() == 2, orbit);
+
+  // new generator reaches new points and points, reached from them
+  vector<DP> newgens{{{2, 3, 4}}, {{2, 3, 4}}, {{5, 6}}, {{4, 5}}};
+  vector<size_t> sizes{4, 4, 4, 6};
+  for (size_t i = 0; i != newgens.size(); ++i) {
+    orbit.extend_orbit(newgens[i]);
+    orbit_check(orbit.size() == sizes[i], orbit);
+    for (auto x = UD6::start; x <= UD6::fin; ++x)
+      orbit_check(orbit.contains(x) == (x <= sizes[i]), orbit);
+    for (auto &&beta : orbit)
+      orbit_check(orbit.ubeta(beta).apply(UD6{1}) == beta, orbit);
+  }
+
+  return 0;
+}
+
+template <template <class...> class Orb> int test_conjugate_orbit() {
+  cout << "Conjugate orbit tests" << endl;
+  using UD6 = UnsignedDomain<1, 6>;
+  using DP = DensePermutation<UD6>;
+
+  // orbit {1, 2, 3, 4} of 1 relabeled by c is orbit {5, 6, 4, 3} of 5
+  vector<DP> gens{{{1, 2}}, {{2, 3, 4}}};
+  Orb<UD6, DP> orbit(UD6{1}, gens.begin(), gens.end());
+  DP c{{1, 5}, {2, 6}, {3, 4}};
+  orbit.conjugate(c);
+  orbit_check(orbit.size() == 4, orbit);
+  for (auto x = UD6::start; x <= UD6::fin; ++x)
+    orbit_check(orbit.contains(x) == (x >= 3), orbit);
+  for (auto &&beta : orbit) {
+    auto u = orbit.ubeta(beta);
+    orbit_check(u.apply(UD6{5}) == beta, orbit);
+    orbit.sift(u, beta);
+    orbit_check(u == DP{}, orbit);
+  }
+
+  // generators are conjugated as well: (4 5)^c = (3 1) joins the rest
+  orbit.extend_orbit(DP{{1, 3}});
+  orbit_check(orbit.size() == 5 && !orbit.contains(UD6{2}), orbit);
+  for (auto &&beta : orbit)
+    orbit_check(orbit.ubeta(beta).apply(UD6{5}) == beta, orbit);
+
+  return 0;
+}
+
+template <template <class...> class Orb> int test_orbit_words() {
+  cout << "Orbit words tests" << endl;
+  using UD7 = UnsignedDomain<1, 7>;
+  using DP = DensePermutation<UD7>;
+
+  vector<DP> gens{{{1, 2, 3}}, {{3, 4, 5, 6, 7}}, {{1, 7}}};
+  Orb<UD7, DP> orbit(UD7{2}, gens.begin(), gens.end());
+  orbit_check(orbit.size() == 7, orbit);
+  for (auto &&beta : orbit) {
+    auto w = orbit.uword(beta);
+    orbit_check(orbit.trace(UD7{2}, w) == beta, orbit);
+
+    // sift by word is multiplication by inverse transversal element
+    DP h{{{1, 2}, {4, 5}}};
+    auto href = product(h, invert(orbit.ubeta(beta)));
+    orbit.sift(h, beta);
+    orbit_check(h == href, orbit);
+  }
+  orbit_check(orbit.uword(UD7{2}).empty(), orbit);
+
+  return 0;
+}
+
+int test_cached_orbit() {
+  cout << "Cached orbit tests" << endl;
+  using UD32 = UnsignedDomain<1, 32>;
+  using DP = DensePermutation<UD32>;
+  using COrb = CachedShreierOrbit<UD32, DP>;
+
+  auto sgens = min_symmetric_gens<UD32>();
+  vector<DP> dsgens(sgens.begin(), sgens.end());
+  FlatShreierOrbit<UD32, DP> ref(UD32{1}, dsgens.begin(), dsgens.end());
+
+  // no cache, tiny cache and cache for everything give the same results
+  for (size_t nentries : {0, 3, 100}) {
+    size_t budget = nentries * COrb::entry_bytes(DP{});
+    COrb::set_default_budget(budget);
+    COrb orbit(UD32{1}, dsgens.begin(), dsgens.end());
+    orbit_check(orbit.size() == 32, orbit);
+    for (int pass = 0; pass < 2; ++pass)
+      for (auto &&beta : ref) {
+        orbit_check(orbit.ubeta(beta) == ref.ubeta(beta), orbit);
+        DP h{{{1, 2}}};
+        DP href = h;
+        orbit.sift(h, beta);
+        ref.sift(href, beta);
+        orbit_check(h == href, orbit);
+        orbit_check(orbit.used_bytes() <= budget, orbit);
+      }
+    orbit_check(orbit.cached() <= nentries, orbit);
+    orbit_check((orbit.cached() == 0) == (nentries == 0), orbit);
+  }
+
+  // loop-form entries differ in size, budget holds anyway
+  using P = Permutation<UD32>;
+  using LOrb = CachedShreierOrbit<UD32, P>;
+  FlatShreierOrbit<UD32, P> lref(UD32{1}, sgens.begin(), sgens.end());
+  size_t lbudget = 5 * LOrb::entry_bytes(P{});
+  orbit_check(LOrb::entry_bytes(lref.ubeta(UD32{2})) < LOrb::entry_bytes(P{}),
+              lref);
+  LOrb::set_default_budget(lbudget);
+  LOrb lorbit(UD32{1}, sgens.begin(), sgens.end());
+  for (auto &&beta : lref) {
+    orbit_check(lorbit.ubeta(beta) == lref.ubeta(beta), lorbit);
+    orbit_check(lorbit.used_bytes() <= lbudget, lorbit);
+  }
+  orbit_check(lorbit.cached() > 0, lorbit);
+  LOrb::set_default_budget(size_t(64) << 20);
+
+  COrb::set_default_budget(size_t(64) << 20);
+  return 0;
+}
+
+int test_shallow_orbit() {
+  cout << "Shallow orbit tests" << endl;
+  using UD64 = UnsignedDomain<1, 64>;
+  using DP = DensePermutation<UD64>;
+
+  // (1 2) and long cycle give depth 63 in plain shreier tree
+  auto sgens = min_symmetric_gens<UD64>();
+  vector<DP> dsgens(sgens.begin(), sgens.end());
+  ShallowShreierOrbit<UD64, DP> orbit(UD64{1}, dsgens.begin(), dsgens.end());
+  orbit_check(orbit.size() == 64, orbit);
+  orbit_check(orbit.nlabels() <= 6, orbit);
+  orbit_check(orbit.depth() <= 2 * orbit.nlabels(), orbit);
+  for (auto &&beta : orbit)
+    orbit_check(orbit.ubeta(beta).apply(UD64{1}) == beta, orbit);
+
+  // random groups with small orbits and big order: generators permute
+  // {1 .. 4} and {5 .. 16} independently. Every label adds new points to
+  // b^C, so labels are bounded by orbit, not by group
+  using UD16 = UnsignedDomain<1, 16>;
+  using DP16 = DensePermutation<UD16>;
+  Xoshiro256 rng(11);
+  for (int iter = 0; iter < 200; ++iter) {
+    vector<DP16> gens;
+    size_t nsmall = 1 + rng.below(4);
+    for (size_t ngens = 2 + rng.below(3); gens.size() != ngens;) {
+      vector<UD16> img;
+      for (unsigned x = 1; x <= 16; ++x)
+        img.push_back(UD16{x});
+      std::shuffle(img.begin(), img.begin() + nsmall, rng);
+      std::shuffle(img.begin() + 4, img.end(), rng);
+      gens.push_back(permutations::perm_from_images<DP16>(img));
+    }
+
+    UD16 b = static_cast<UD16>(1 + rng.below(16));
+    ShallowShreierOrbit<UD16, DP16> rorb(b, gens.begin(), gens.end());
+    orbit_check(rorb.nlabels() < rorb.size() || rorb.size() == 1, rorb);
+    orbit_check(rorb.depth() <= 2 * rorb.nlabels(), rorb);
+    if (b <= 4)
+      orbit_check(rorb.size() <= 4 && rorb.nlabels() <= 3, rorb);
+    for (auto &&beta : rorb)
+      orbit_check(rorb.ubeta(beta).apply(b) == beta, rorb);
+  }
+
+  return 0;
+}
+
+// every point: ubeta maps root to it, sift by ubeta gives id, word traces
+template <typename Orb> void check_action_orbit(const Orb &orbit) {
+  for (auto &&p : orbit) {
+    auto u = orbit.ubeta(p);
+    orbit_check(orbit.image(orbit.root(), u) == p, orbit);
+    auto h = u;
+    orbit.sift(h, p);
+    orbit_check(h == u.id(), orbit);
+    orbit_check(orbit.trace(orbit.root(), orbit.uword(p)) == p, orbit);
+  }
+}
+
+// conjugation g^-1 * p * g as user action on permutations
+struct OnConjugates {
+  template <typename Perm> Perm operator()(const Perm &p, const Perm &g) const {
+    return product(product(invert(g), p), g);
+  }
+};
+
+int test_action_orbit() {
+  cout << "Action orbit tests" << endl;
+  using UD5 = UnsignedDomain<1, 5>;
+  using P = Permutation<UD5>;
+  auto sgens = symmetric_gens<UD5>();
+  auto cgens = cyclic_gens<UD5>();
+
+  // points: same as plain orbit
+  ActionOrbit<UD5, P, OnPoints<UD5>> porb(UD5{2}, cgens.begin(), cgens.end());
+  orbit_check(porb.size() == 5, porb);
+  check_action_orbit(porb);
+
+  // Sym(5) is 2-transitive: two orbitals
+  PairOrbit<UD5> diag({UD5{1}, UD5{1}}, sgens.begin(), sgens.end());
+  PairOrbit<UD5> offdiag({UD5{1}, UD5{2}}, sgens.begin(), sgens.end());
+  orbit_check(diag.size() == 5, diag);
+  orbit_check(offdiag.size() == 20, offdiag);
+  orbit_check(!offdiag.contains({UD5{3}, UD5{3}}), offdiag);
+  check_action_orbit(offdiag);
+
+  // ordered triples and 2-subsets
+  TupleOrbit<UD5> torb({3, 1, 4}, sgens.begin(), sgens.end());
+  orbit_check(torb.size() == 60, torb);
+  check_action_orbit(torb);
+
+  SetOrbit<UD5> sorb({1, 2}, cgens.begin(), cgens.end());
+  orbit_check(sorb.size() == 5, sorb);
+  orbit_check(sorb.contains({1, 5}) && !sorb.contains({1, 3}), sorb);
+  check_action_orbit(sorb);
+
+  // unsorted starting set is the same orbit, repeating points are rejected
+  SetOrbit<UD5> usorb({2, 1}, cgens.begin(), cgens.end());
+  orbit_check(usorb.size() == 5 && usorb.root() == sorb.root(), usorb);
+  bool thrown = false;
+  try {
+    SetOrbit<UD5> bad({1, 1}, cgens.begin(), cgens.end());
+  } catch (std::invalid_argument &) {
+    thrown = true;
+  }
+  orbit_check(thrown, usorb);
+
+  // orbitals of big degree are hashed, small ones use rank table
+  using UD4K = UnsignedDomain<1, 4096>;
+  using DP4K = DensePermutation<UD4K>;
+  vector<DP4K> bgens{DP4K{{1, 2, 3}}};
+  PairOrbit<UD4K, DP4K> borb({UD4K{1}, UD4K{2}}, bgens.begin(), bgens.end());
+  orbit_check(borb.size() == 3 && !borb.rank_table(), borb);
+  check_action_orbit(borb);
+  orbit_check(offdiag.rank_table(), offdiag);
+
+  // extending cyclic group to dihedral does not join {1, 2} and {1, 3}
+  sorb.extend_orbit(P{{2, 5}, {3, 4}});
+  orbit_check(sorb.size() == 5 && !sorb.contains({1, 3}), sorb);
+  sorb.extend_orbit(P{{1, 2}});
+  orbit_check(sorb.size() == 10, sorb);
+  check_action_orbit(sorb);
+
+  // transpositions are conjugacy class of size 10
+  ActionOrbit<P, P, OnConjugates> corb(P{{1, 2}}, sgens.begin(), sgens.end());
+  orbit_check(corb.size() == 10, corb);
+  check_action_orbit(corb);
+
+  thrown = false;
+  try {
+    corb.ubeta(P{{1, 2, 3}});
+  } catch (std::out_of_range &) {
+    thrown = true;
+  }
+  orbit_check(thrown, corb);
+
+  return 0;
+}
+
 int main() {
   try {
     test_simple_orbit<DirectOrbit>();
     test_simple_orbit<ShreierOrbit>();
+    test_simple_orbit<FlatDirectOrbit>();
+    test_simple_orbit<FlatShreierOrbit>();
+    test_simple_orbit<ShallowShreierOrbit>();
+    test_simple_orbit<CachedShreierOrbit>();
+    test_dense_orbit<DirectOrbit>();
+    test_dense_orbit<ShreierOrbit>();
+    test_dense_orbit<FlatDirectOrbit>();
+    test_dense_orbit<FlatShreierOrbit>();
+    test_dense_orbit<ShallowShreierOrbit>();
+    test_dense_orbit<CachedShreierOrbit>();
+    test_extend_orbit<DirectOrbit>();
+    test_extend_orbit<ShreierOrbit>();
+    test_extend_orbit<FlatDirectOrbit>();
+    test_extend_orbit<FlatShreierOrbit>();
+    test_extend_orbit<ShallowShreierOrbit>();
+    test_extend_orbit<CachedShreierOrbit>();
+    test_conjugate_orbit<DirectOrbit>();
+    test_conjugate_orbit<ShreierOrbit>();
+    test_conjugate_orbit<FlatDirectOrbit>();
+    test_conjugate_orbit<FlatShreierOrbit>();
+    test_conjugate_orbit<ShallowShreierOrbit>();
+    test_conjugate_orbit<CachedShreierOrbit>();
+    test_shallow_orbit();
+    test_orbit_words<ShreierOrbit>();
+    test_orbit_words<FlatShreierOrbit>();
+    test_orbit_words<ShallowShreierOrbit>();
+    test_orbit_words<CachedShreierOrbit>();
+    test_cached_orbit();
+    test_action_orbit();
   } catch (exception &e) {
     cerr << "Failed: " << e.what() << endl;
     exit(-1);
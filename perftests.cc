@@ -6,12 +6,33 @@
 // g++ --std=c++17 -Wfatal-errors perftests.cc -O3 -DNDEBUG -S -fno-exceptions
 // -fno-rtti
 
+#include <cstdio>
+#include <fstream>
+
+#include "actions.hpp"
+#include "backtrack.hpp"
+#include "bsgs.hpp"
 #include "groups.hpp"
 #include "idomain.hpp"
+#include "permio.hpp"
+#include "permpacked.hpp"
+#include "stabchain.hpp"
 
+using orbits::CachedShreierOrbit;
 using orbits::DirectOrbit;
+using orbits::FlatDirectOrbit;
+using orbits::FlatShreierOrbit;
+using orbits::PairOrbit;
+using orbits::SetOrbit;
+using orbits::ShallowShreierOrbit;
 using orbits::ShreierOrbit;
+using orbits::TupleOrbit;
+using permutations::DensePermutation;
+using permutations::FastPermutation;
+using permutations::PermFormat;
 using permutations::PermLoop;
+using permutations::PermReader;
+using permutations::PermWriter;
 using namespace groups;
 using namespace groupgens;
 
@@ -39,6 +60,7 @@ using namespace groupgens;
 // say with gens: (1, 2) and (1, 2, 3, 4, 5, 6, 7, 8, 9)
 // going from 1 to 9 involves 9 applications and sv looks like:
 // [-1, 1, 2, 2, 2, 2, 2, 2, 2]
+// shallow shreier orbit keeps depth under 2 log2(SORBS)
 #ifndef SORBS_01
 #define SORBS_01 400
 #endif
@@ -94,7 +116,379 @@ bool perftest_orbit_02(T elt) {
   return result;
 }
 
-int main() {
+  //------------------------------------------------------------------------------
+  //
+  // 03: minimal generating set for symmetric group, dense permutations
+  //
+  //------------------------------------------------------------------------------
+
+#ifndef DORBC_03
+#define DORBC_03 1
+#endif
+
+#ifndef SORBC_03
+#define SORBC_03 1
+#endif
+
+// same as test 01, but generators and transversals are image tables
+#ifndef DORBS_03
+#define DORBS_03 2000
+#endif
+
+#ifndef SORBS_03
+#define SORBS_03 400
+#endif
+
+template <template <class...> class Orb, typename T>
+bool perftest_orbit_03(T elt) {
+  auto result = true;
+  auto lgens = min_symmetric_gens<T>();
+  vector<DensePermutation<T>> gens(lgens.begin(), lgens.end());
+  Orb<T, DensePermutation<T>> orbit(elt, gens.begin(), gens.end());
+  for (auto &&beta : orbit) {
+    auto u_beta = orbit.ubeta(beta);
+    result = result && (u_beta.apply(elt) == beta);
+  }
+  return result;
+}
+
+  //------------------------------------------------------------------------------
+  //
+  // 04: enumerating all elements of small symmetric group
+  //
+  //------------------------------------------------------------------------------
+
+// loop form vs packed form (compile with -march=native for shuffles)
+#ifndef ALLS_04
+#define ALLS_04 8
+#endif
+
+template <typename Perm> size_t perftest_all_04(bool parallel = false) {
+  using T = typename Perm::value_type;
+  auto lgens = min_symmetric_gens<T>();
+  vector<Perm> gens(lgens.begin(), lgens.end());
+  vector<Perm> all;
+  if (parallel)
+    return all_elements_parallel(gens.begin(), gens.end(), back_inserter(all));
+  return all_elements(gens.begin(), gens.end(), back_inserter(all));
+}
+
+  //------------------------------------------------------------------------------
+  //
+  // 05: same as 03, but degree is set at runtime
+  //
+  //------------------------------------------------------------------------------
+
+// degree may be also passed as first command line argument
+#ifndef RORBS_05
+#define RORBS_05 2000
+#endif
+
+using RD_05 = UnsignedRuntimeDomain<>;
+
+  //------------------------------------------------------------------------------
+  //
+  // 06: streaming all elements of symmetric group from BSGS
+  //
+  //------------------------------------------------------------------------------
+
+// Sym(10) is 3628800 elements, none of them stored
+#ifndef ALLS_06
+#define ALLS_06 10
+#endif
+
+template <typename Perm> size_t perftest_stream_06() {
+  using T = typename Perm::value_type;
+  auto lgens = min_symmetric_gens<T>();
+  vector<Perm> gens(lgens.begin(), lgens.end());
+  auto[B, S, Delta] = shreier_sims<ShreierOrbit>(gens.begin(), gens.end());
+  size_t nfixed = 0;
+  for_each_element(Delta.begin(), Delta.end(), [&](const Perm &g) {
+    nfixed += (g.apply(T::start) == T::start);
+  });
+  return nfixed;
+}
+
+  //------------------------------------------------------------------------------
+  //
+  // 07: Schreier-Sims for symmetric group, dense permutations
+  //
+  //------------------------------------------------------------------------------
+
+#ifndef SSIMS_07
+#define SSIMS_07 40
+#endif
+
+template <template <class...> class Orb, typename T>
+size_t perftest_ss_07(bool randomized = false) {
+  auto lgens = min_symmetric_gens<T>();
+  vector<DensePermutation<T>> gens(lgens.begin(), lgens.end());
+  if (randomized) {
+    auto[B, S, Delta] = random_shreier_sims<Orb>(gens.begin(), gens.end());
+    return B.size();
+  }
+  auto[B, S, Delta] = shreier_sims<Orb>(gens.begin(), gens.end());
+  return B.size();
+}
+
+  //------------------------------------------------------------------------------
+  //
+  // 08: batch membership in alternating group
+  //
+  //------------------------------------------------------------------------------
+
+#ifndef MEMBS_08
+#define MEMBS_08 64
+#endif
+
+// number of random queries, half of them are in group
+#ifndef MEMBQ_08
+#define MEMBQ_08 200000
+#endif
+
+template <typename T> struct Membership08 {
+  using Perm = DensePermutation<T>;
+  vector<T> B;
+  vector<vector<Perm>> S;
+  vector<FlatShreierOrbit<T, Perm>> Delta;
+  vector<Perm> queries;
+
+  Membership08() {
+    auto lgens = alternating_gens<T>();
+    vector<Perm> gens(lgens.begin(), lgens.end());
+    std::tie(B, S, Delta) =
+        shreier_sims<FlatShreierOrbit>(gens.begin(), gens.end());
+    auto &g = mtgen();
+    vector<T> img(T::fin - T::start + 1);
+    iota(img.begin(), img.end(), T::start);
+    for (size_t k = 0; k != MEMBQ_08; ++k) {
+      std::shuffle(img.begin(), img.end(), g);
+      queries.emplace_back(img);
+    }
+  }
+
+  size_t strip_one() {
+    size_t nin = 0;
+    for (auto &&q : queries) {
+      auto res = strip(q, B.begin(), B.end(), Delta.begin());
+      nin += (res.first == Perm{} && res.second == B.end());
+    }
+    return nin;
+  }
+
+  void save_chain(const string &fname) {
+    StabChain<Perm> chain(B.begin(), B.end(), S.begin(), Delta.begin());
+    std::ofstream ofs(fname, std::ios::binary);
+    chain.save(ofs);
+  }
+
+  size_t strip_mapped(const string &fname) {
+    auto chain = StabChain<Perm>::map_file(fname);
+    vector<char> res(queries.size());
+    return chain.strip_all(queries.begin(), queries.end(), res.begin());
+  }
+
+  size_t strip_chain(size_t nthreads) {
+    StabChain<Perm> chain(B.begin(), B.end(), S.begin(), Delta.begin());
+    vector<char> res(queries.size());
+    return chain.strip_all(queries.begin(), queries.end(), res.begin(),
+                           nthreads);
+  }
+};
+
+  //------------------------------------------------------------------------------
+  //
+  // 09: writing and reading permutations in text form
+  //
+  //------------------------------------------------------------------------------
+
+#ifndef IOS_09
+#define IOS_09 64
+#endif
+
+#ifndef IOQ_09
+#define IOQ_09 200000
+#endif
+
+template <typename T> struct PermIO09 {
+  using Perm = DensePermutation<T>;
+  vector<Perm> perms;
+  string text;
+
+  PermIO09() {
+    auto &g = mtgen();
+    vector<T> img(T::fin - T::start + 1);
+    iota(img.begin(), img.end(), T::start);
+    for (size_t k = 0; k != IOQ_09; ++k) {
+      std::shuffle(img.begin(), img.end(), g);
+      perms.emplace_back(img);
+    }
+  }
+
+  size_t write(PermFormat fmt) {
+    stringstream ss;
+    {
+      PermWriter<Perm> wr(ss, fmt);
+      wr.write(perms.begin(), perms.end());
+    }
+    text = ss.str();
+    return text.size();
+  }
+
+  size_t read(PermFormat fmt) {
+    stringstream ss(text);
+    PermReader<Perm> rd(ss, fmt);
+    vector<Perm> res;
+    return rd.read_all(back_inserter(res));
+  }
+};
+
+  //------------------------------------------------------------------------------
+  //
+  // 10: block systems of cyclic group
+  //
+  //------------------------------------------------------------------------------
+
+// single block system for degree BLKS_10, all minimal ones for BLKM_10
+#ifndef BLKS_10
+#define BLKS_10 10000
+#endif
+
+#ifndef BLKM_10
+#define BLKM_10 2000
+#endif
+
+template <typename T> size_t perftest_blocks_10() {
+  auto gens = cyclic_gens<T>();
+  auto blocks =
+      primitive_blocks(T{T::start}, T{T::fin}, gens.begin(), gens.end());
+  return blocks.size();
+}
+
+template <typename T> size_t perftest_minblocks_10() {
+  auto gens = cyclic_gens<T>();
+  auto systems = minimal_block_systems(gens.begin(), gens.end());
+  return systems.size();
+}
+
+//------------------------------------------------------------------------------
+//
+// 11: setwise stabilizer in symmetric group
+//
+//------------------------------------------------------------------------------
+
+// stabilizer of {1 .. SETK_11} in Sym(SETN_11), brute force visits all
+// SETN_11! elements
+#ifndef SETN_11
+#define SETN_11 10
+#endif
+
+#ifndef SETK_11
+#define SETK_11 5
+#endif
+
+template <typename T> size_t perftest_setwise_11() {
+  auto gens = symmetric_gens<T>();
+  vector<T> pts(SETK_11);
+  iota(pts.begin(), pts.end(), T::start);
+  auto[B, S, Delta] = setwise_stabilizer<FlatShreierOrbit>(
+      gens.begin(), gens.end(), pts.begin(), pts.end());
+  return group_order(Delta.begin(), Delta.end());
+}
+
+template <typename T> size_t perftest_setwise_brute_11() {
+  auto gens = symmetric_gens<T>();
+  auto[B, S, Delta] =
+      shreier_sims<FlatShreierOrbit>(gens.begin(), gens.end());
+  size_t ord = 0;
+  for_each_element(Delta.begin(), Delta.end(), [&ord](const auto &g) {
+    for (auto x = T::start; x != T::start + SETK_11; ++x)
+      if (g.apply(x) >= T::start + SETK_11)
+        return;
+    ord += 1;
+  });
+  return ord;
+}
+
+//------------------------------------------------------------------------------
+//
+// 12: centralizer and conjugacy in symmetric group
+//
+//------------------------------------------------------------------------------
+
+// Sym(CENTN_12) has order about 10^12, brute force is out of question
+#ifndef CENTN_12
+#define CENTN_12 15
+#endif
+
+// element with cycles of lengths 1, 2, 3 ... while they fit
+template <typename T> Permutation<T> perftest_element_12(size_t shift) {
+  vector<T> pts(T::fin - T::start + 1);
+  iota(pts.begin(), pts.end(), T::start);
+  std::rotate(pts.begin(), pts.begin() + shift, pts.end());
+  Permutation<T> g{};
+  size_t pos = 0;
+  for (size_t len = 1; pos + len <= pts.size(); pos += len, ++len)
+    if (len > 1)
+      g.rmul(Permutation<T>{PermLoop<T>(pts.begin() + pos,
+                                        pts.begin() + pos + len)});
+  return g;
+}
+
+template <typename T> size_t perftest_centralizer_12() {
+  auto gens = symmetric_gens<T>();
+  auto g = perftest_element_12<T>(0);
+  auto[B, S, Delta] =
+      centralizer<FlatShreierOrbit>(gens.begin(), gens.end(), g);
+  return group_order(Delta.begin(), Delta.end());
+}
+
+template <typename T> bool perftest_conjugacy_12() {
+  auto gens = symmetric_gens<T>();
+  auto g = perftest_element_12<T>(0);
+  auto h = perftest_element_12<T>(7);
+  auto x = is_conjugate<FlatShreierOrbit>(gens.begin(), gens.end(), g, h);
+  return x && product(product(invert(*x), g), *x) == h;
+}
+
+//------------------------------------------------------------------------------
+//
+// 13: orbits on pairs and subsets
+//
+//------------------------------------------------------------------------------
+
+// orbital of Sym(ACTN_13), ranked (pairs) vs hashed (2-tuples) storage, and
+// orbit of 3-subsets of ACTK_13 points
+#ifndef ACTN_13
+#define ACTN_13 300
+#endif
+
+#ifndef ACTK_13
+#define ACTK_13 100
+#endif
+
+template <typename T> size_t perftest_pairs_13() {
+  auto sgens = symmetric_gens<T>();
+  vector<DensePermutation<T>> gens(sgens.begin(), sgens.end());
+  PairOrbit<T, DensePermutation<T>> orb({T{1}, T{2}}, gens.begin(), gens.end());
+  return orb.size();
+}
+
+template <typename T> size_t perftest_tuples_13() {
+  auto sgens = symmetric_gens<T>();
+  vector<DensePermutation<T>> gens(sgens.begin(), sgens.end());
+  TupleOrbit<T, DensePermutation<T>> orb({1, 2}, gens.begin(), gens.end());
+  return orb.size();
+}
+
+template <typename T> size_t perftest_sets_13() {
+  auto sgens = symmetric_gens<T>();
+  vector<DensePermutation<T>> gens(sgens.begin(), sgens.end());
+  SetOrbit<T, DensePermutation<T>> orb({1, 2, 3}, gens.begin(), gens.end());
+  return orb.size();
+}
+
+int main(int argc, char **argv) {
   // some cache warmup
   UnsignedDomain<1, 1000> elt = 1;
   perftest_orbit_01<DirectOrbit>(elt);
@@ -123,6 +517,16 @@ int main() {
     }
   });
   cout << tsorb_01.count() << ", " << res << endl;
+
+  res = true;
+  cout << "shallow shreier orbit: ";
+  auto tssorb_01 = duration([&] {
+    for (int x = 1; x <= SORBC_01; ++x) {
+      UnsignedDomain<1, SORBS_01> elt = x;
+      res = res && perftest_orbit_01<ShallowShreierOrbit>(elt);
+    }
+  });
+  cout << tssorb_01.count() << ", " << res << endl;
 #endif
 
 // test 02: shallow generating set for symmetric group
@@ -146,4 +550,217 @@ int main() {
   });
   cout << tsorb_02.count() << ", " << res << endl;
 #endif
+
+// test 03: minimal generating set for symmetric group, dense permutations
+#ifndef NOTEST_03
+  res = true;
+  cout << "dense direct orbit: ";
+  auto tdorb_03 = duration([&] {
+    for (int x = 1; x <= DORBC_03; ++x) {
+      UnsignedDomain<1, DORBS_03> elt = x;
+      res = res && perftest_orbit_03<DirectOrbit>(elt);
+    }
+  });
+  cout << tdorb_03.count() << ", " << res << endl;
+
+  res = true;
+  cout << "dense shreier orbit: ";
+  auto tsorb_03 = duration([&] {
+    for (int x = 1; x <= SORBC_03; ++x) {
+      UnsignedDomain<1, SORBS_03> elt = x;
+      res = res && perftest_orbit_03<ShreierOrbit>(elt);
+    }
+  });
+  cout << tsorb_03.count() << ", " << res << endl;
+
+  res = true;
+  cout << "flat dense direct orbit: ";
+  auto tfdorb_03 = duration([&] {
+    for (int x = 1; x <= DORBC_03; ++x) {
+      UnsignedDomain<1, DORBS_03> elt = x;
+      res = res && perftest_orbit_03<FlatDirectOrbit>(elt);
+    }
+  });
+  cout << tfdorb_03.count() << ", " << res << endl;
+
+  res = true;
+  cout << "flat dense shreier orbit: ";
+  auto tfsorb_03 = duration([&] {
+    for (int x = 1; x <= SORBC_03; ++x) {
+      UnsignedDomain<1, SORBS_03> elt = x;
+      res = res && perftest_orbit_03<FlatShreierOrbit>(elt);
+    }
+  });
+  cout << tfsorb_03.count() << ", " << res << endl;
+#endif
+
+// test 04: enumerating all elements of small symmetric group
+#ifndef NOTEST_04
+  using UDA_04 = UnsignedDomain<1, ALLS_04>;
+  size_t nall = 0;
+  cout << "loop all elements: ";
+  auto tlall_04 =
+      duration([&] { nall = perftest_all_04<Permutation<UDA_04>>(); });
+  cout << tlall_04.count() << ", " << nall << endl;
+
+  cout << "packed all elements: ";
+  auto tpall_04 =
+      duration([&] { nall = perftest_all_04<FastPermutation<UDA_04>>(); });
+  cout << tpall_04.count() << ", " << nall << endl;
+
+  cout << "parallel packed all elements: ";
+  auto tppall_04 = duration(
+      [&] { nall = perftest_all_04<FastPermutation<UDA_04>>(true); });
+  cout << tppall_04.count() << ", " << nall << endl;
+#endif
+
+// test 05: runtime degree, one instantiation for any size
+#ifndef NOTEST_05
+  unsigned rdeg_05 = (argc > 1) ? std::stoul(argv[1]) : RORBS_05;
+  RD_05::set_bounds(1, rdeg_05);
+  res = true;
+  cout << "runtime dense direct orbit: ";
+  auto trorb_05 =
+      duration([&] { res = perftest_orbit_03<DirectOrbit>(RD_05{1}); });
+  cout << trorb_05.count() << ", " << res << endl;
+#endif
+
+// test 06: constant memory walk over large group
+#ifndef NOTEST_06
+  using UDA_06 = UnsignedDomain<1, ALLS_06>;
+  size_t nfixed = 0;
+  cout << "streamed elements fixing start: ";
+  auto tstream_06 = duration(
+      [&] { nfixed = perftest_stream_06<DensePermutation<UDA_06>>(); });
+  cout << tstream_06.count() << ", " << nfixed << endl;
+#endif
+
+// test 07: sifting through words of shreier vectors
+#ifndef NOTEST_07
+  using UDS_07 = UnsignedDomain<1, SSIMS_07>;
+  size_t nbase = 0;
+  cout << "flat shreier schreier-sims: ";
+  auto tfss_07 =
+      duration([&] { nbase = perftest_ss_07<FlatShreierOrbit, UDS_07>(); });
+  cout << tfss_07.count() << ", " << nbase << endl;
+
+  cout << "shallow shreier schreier-sims: ";
+  auto tsss_07 = duration(
+      [&] { nbase = perftest_ss_07<ShallowShreierOrbit, UDS_07>(); });
+  cout << tsss_07.count() << ", " << nbase << endl;
+
+  cout << "cached shreier schreier-sims: ";
+  auto tcss_07 = duration(
+      [&] { nbase = perftest_ss_07<CachedShreierOrbit, UDS_07>(); });
+  cout << tcss_07.count() << ", " << nbase << endl;
+
+  cout << "randomized shallow shreier schreier-sims: ";
+  auto trss_07 = duration(
+      [&] { nbase = perftest_ss_07<ShallowShreierOrbit, UDS_07>(true); });
+  cout << trss_07.count() << ", " << nbase << endl;
+#endif
+
+// test 08: batch membership on immutable chain
+#ifndef NOTEST_08
+  using UDM_08 = UnsignedDomain<1, MEMBS_08>;
+  Membership08<UDM_08> memb_08;
+  size_t nin_08 = 0;
+  cout << "strip one by one: ";
+  auto tone_08 = duration([&] { nin_08 = memb_08.strip_one(); });
+  cout << tone_08.count() << ", " << nin_08 << endl;
+
+  cout << "chain strip_all, one thread: ";
+  auto tch1_08 = duration([&] { nin_08 = memb_08.strip_chain(1); });
+  cout << tch1_08.count() << ", " << nin_08 << endl;
+
+  cout << "chain strip_all, all threads: ";
+  auto tchn_08 = duration([&] { nin_08 = memb_08.strip_chain(0); });
+  cout << tchn_08.count() << ", " << nin_08 << endl;
+
+  string fname_08 = "/tmp/cgt_perftest_08.bin";
+  memb_08.save_chain(fname_08);
+  cout << "mapped chain strip_all: ";
+  auto tmap_08 = duration([&] { nin_08 = memb_08.strip_mapped(fname_08); });
+  cout << tmap_08.count() << ", " << nin_08 << endl;
+  std::remove(fname_08.c_str());
+#endif
+
+// test 09: text io of permutations
+#ifndef NOTEST_09
+  PermIO09<UnsignedDomain<1, IOS_09>> io_09;
+  for (auto fmt : {PermFormat::Cycles, PermFormat::Images}) {
+    const char *name = (fmt == PermFormat::Cycles) ? "cycles" : "images";
+    size_t nio_09 = 0;
+    cout << "write " << name << ": ";
+    auto twr_09 = duration([&] { nio_09 = io_09.write(fmt); });
+    cout << twr_09.count() << ", " << nio_09 << endl;
+
+    cout << "read " << name << ": ";
+    auto trd_09 = duration([&] { nio_09 = io_09.read(fmt); });
+    cout << trd_09.count() << ", " << nio_09 << endl;
+  }
+#endif
+
+// test 10: union-find block systems
+#ifndef NOTEST_10
+  size_t nblk_10 = 0;
+  cout << "primitive blocks: ";
+  auto tblk_10 = duration(
+      [&] { nblk_10 = perftest_blocks_10<UnsignedDomain<1, BLKS_10>>(); });
+  cout << tblk_10.count() << ", " << nblk_10 << endl;
+
+  cout << "minimal block systems: ";
+  auto tmblk_10 = duration(
+      [&] { nblk_10 = perftest_minblocks_10<UnsignedDomain<1, BLKM_10>>(); });
+  cout << tmblk_10.count() << ", " << nblk_10 << endl;
+#endif
+
+// test 11: setwise stabilizer in symmetric group
+#ifndef NOTEST_11
+  size_t ord_11 = 0;
+  cout << "setwise stabilizer backtrack: ";
+  auto tset_11 = duration(
+      [&] { ord_11 = perftest_setwise_11<UnsignedDomain<1, SETN_11>>(); });
+  cout << tset_11.count() << ", " << ord_11 << endl;
+
+  cout << "setwise stabilizer brute force: ";
+  auto tbrute_11 = duration([&] {
+    ord_11 = perftest_setwise_brute_11<UnsignedDomain<1, SETN_11>>();
+  });
+  cout << tbrute_11.count() << ", " << ord_11 << endl;
+#endif
+
+// test 12: centralizer and conjugacy in symmetric group
+#ifndef NOTEST_12
+  size_t ord_12 = 0;
+  cout << "centralizer: ";
+  auto tcent_12 = duration(
+      [&] { ord_12 = perftest_centralizer_12<UnsignedDomain<1, CENTN_12>>(); });
+  cout << tcent_12.count() << ", " << ord_12 << endl;
+
+  bool conj_12 = false;
+  cout << "conjugacy: ";
+  auto tconj_12 = duration(
+      [&] { conj_12 = perftest_conjugacy_12<UnsignedDomain<1, CENTN_12>>(); });
+  cout << tconj_12.count() << ", " << conj_12 << endl;
+#endif
+
+// test 13: orbits on pairs and subsets
+#ifndef NOTEST_13
+  size_t sz_13 = 0;
+  cout << "orbit on pairs: ";
+  auto tpairs_13 = duration(
+      [&] { sz_13 = perftest_pairs_13<UnsignedDomain<1, ACTN_13>>(); });
+  cout << tpairs_13.count() << ", " << sz_13 << endl;
+
+  cout << "orbit on 2-tuples: ";
+  auto ttuples_13 = duration(
+      [&] { sz_13 = perftest_tuples_13<UnsignedDomain<1, ACTN_13>>(); });
+  cout << ttuples_13.count() << ", " << sz_13 << endl;
+
+  cout << "orbit on 3-subsets: ";
+  auto tsets_13 = duration(
+      [&] { sz_13 = perftest_sets_13<UnsignedDomain<1, ACTK_13>>(); });
+  cout << tsets_13.count() << ", " << sz_13 << endl;
+#endif
 }
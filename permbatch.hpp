@@ -0,0 +1,302 @@
+//------------------------------------------------------------------------------
+//
+//  Batches of permutations
+//
+//------------------------------------------------------------------------------
+//
+// PermBatch<T> keeps count permutations over domain T as structure of arrays:
+// zero-based image of point i under permutation k lives at i * count + k,
+// so images of one point under all permutations are contiguous.
+//
+// In this layout product of k-th permutations for all k at once is one gather
+// per point: out(i, k) = rhs(lhs(i, k), k). With -mavx2 or -mavx512f gathers
+// are done 8 or 16 lanes at a time, otherwise plain loop is used.
+//
+// Multiplying whole batch by single permutation is cheaper still: on the
+// right it is gather from small table, on the left it is rows reordering.
+//
+//------------------------------------------------------------------------------
+
+#ifndef PERMBATCH_GUARD_
+#define PERMBATCH_GUARD_
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "permcommon.hpp"
+#include "permdense.hpp"
+
+namespace permutations {
+
+//------------------------------------------------------------------------------
+//
+// Kernels over raw image tables
+//
+//------------------------------------------------------------------------------
+
+// out[i * count + k] = rhs[lhs[i * count + k] * count + k]
+// out may alias lhs, but not rhs
+inline void compose_batch(const uint32_t *lhs, const uint32_t *rhs,
+                          uint32_t *out, size_t degree, size_t count);
+
+// tbl[i * count + k] = img[tbl[i * count + k]], i.e. right multiply all
+// permutations in table by single permutation given by zero-based images
+inline void rmul_batch(uint32_t *tbl, const uint32_t *img, size_t degree,
+                       size_t count);
+
+//------------------------------------------------------------------------------
+//
+// Permutation batch template
+//
+//------------------------------------------------------------------------------
+
+template <typename T> class PermBatch {
+  size_t degree_;
+  size_t count_;
+  vector<uint32_t> tbl_;
+
+public:
+  using value_type = T;
+
+  // ctors/dtors
+public:
+  // count id permutations over domain
+  explicit PermBatch(size_t count = 0);
+
+  // from range of permutations of any kind
+  template <typename FwdIt> PermBatch(FwdIt pbeg, FwdIt pend);
+
+  // modifiers
+public:
+  // put permutation at position k
+  template <typename Perm> void set(size_t k, const Perm &p);
+
+  // this[k] = lhs[k] * rhs[k] for all k
+  void assign_product(const PermBatch &lhs, const PermBatch &rhs);
+
+  // this[k] = this[k] * rhs[k] for all k
+  PermBatch &rmul(const PermBatch &rhs) {
+    assert(rhs.count_ == count_);
+    compose_batch(tbl_.data(), rhs.tbl_.data(), tbl_.data(), degree_, count_);
+    return *this;
+  }
+
+  // this[k] = this[k] * p for all k
+  PermBatch &rmul(const DensePermutation<T> &p);
+
+  // this[k] = p * this[k] for all k
+  PermBatch &lmul(const DensePermutation<T> &p);
+
+  // selectors
+public:
+  size_t size() const { return count_; }
+
+  // apply k-th permutation to elem
+  T apply(size_t k, T elem) const {
+    return static_cast<T>(T::start + tbl_[(elem - T::start) * count_ + k]);
+  }
+
+  // k-th permutation
+  DensePermutation<T> get(size_t k) const;
+
+  // write all permutations to output iterator
+  template <typename OutIt> void get_all(OutIt out) const {
+    for (size_t k = 0; k != count_; ++k)
+      *out++ = get(k);
+  }
+
+  // raw table
+  const uint32_t *data() const { return tbl_.data(); }
+};
+
+//------------------------------------------------------------------------------
+//
+// Standalone operations
+//
+//------------------------------------------------------------------------------
+
+// products of corresponding elements of two batches
+template <typename T>
+PermBatch<T> product(const PermBatch<T> &lhs, const PermBatch<T> &rhs) {
+  PermBatch<T> retval(lhs.size());
+  retval.assign_product(lhs, rhs);
+  return retval;
+}
+
+//------------------------------------------------------------------------------
+//
+// Kernels implementation
+//
+//------------------------------------------------------------------------------
+
+inline void compose_batch(const uint32_t *lhs, const uint32_t *rhs,
+                          uint32_t *out, size_t degree, size_t count) {
+  assert((rhs != out) || (degree * count == 0));
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+  // gathers take signed 32-bit indices
+  bool vectorize =
+      (degree * count <= static_cast<size_t>(std::numeric_limits<int>::max()));
+#endif
+
+  for (size_t i = 0; i != degree; ++i) {
+    const uint32_t *l = lhs + i * count;
+    uint32_t *o = out + i * count;
+    size_t k = 0;
+
+#if defined(__AVX512F__)
+    if (vectorize) {
+      const __m512i vcount = _mm512_set1_epi32(static_cast<int>(count));
+      __m512i vk = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+                                     13, 14, 15);
+      const __m512i vstep = _mm512_set1_epi32(16);
+      for (; k + 16 <= count; k += 16) {
+        __m512i vl = _mm512_loadu_si512(l + k);
+        __m512i vidx = _mm512_add_epi32(_mm512_mullo_epi32(vl, vcount), vk);
+        _mm512_storeu_si512(o + k, _mm512_i32gather_epi32(vidx, rhs, 4));
+        vk = _mm512_add_epi32(vk, vstep);
+      }
+    }
+#elif defined(__AVX2__)
+    if (vectorize) {
+      const __m256i vcount = _mm256_set1_epi32(static_cast<int>(count));
+      __m256i vk = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+      const __m256i vstep = _mm256_set1_epi32(8);
+      for (; k + 8 <= count; k += 8) {
+        __m256i vl =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(l + k));
+        __m256i vidx = _mm256_add_epi32(_mm256_mullo_epi32(vl, vcount), vk);
+        __m256i vres = _mm256_i32gather_epi32(
+            reinterpret_cast<const int *>(rhs), vidx, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(o + k), vres);
+        vk = _mm256_add_epi32(vk, vstep);
+      }
+    }
+#endif
+
+    for (; k < count; ++k)
+      o[k] = rhs[l[k] * count + k];
+  }
+}
+
+inline void rmul_batch(uint32_t *tbl, const uint32_t *img, size_t degree,
+                       size_t count) {
+  size_t n = degree * count;
+  size_t k = 0;
+
+#if defined(__AVX512F__)
+  for (; k + 16 <= n; k += 16) {
+    __m512i vl = _mm512_loadu_si512(tbl + k);
+    _mm512_storeu_si512(tbl + k, _mm512_i32gather_epi32(vl, img, 4));
+  }
+#elif defined(__AVX2__)
+  for (; k + 8 <= n; k += 8) {
+    __m256i vl =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tbl + k));
+    __m256i vres =
+        _mm256_i32gather_epi32(reinterpret_cast<const int *>(img), vl, 4);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(tbl + k), vres);
+  }
+#endif
+
+  for (; k < n; ++k)
+    tbl[k] = img[tbl[k]];
+}
+
+//------------------------------------------------------------------------------
+//
+// Ctors/dtors
+//
+//------------------------------------------------------------------------------
+
+template <typename T>
+PermBatch<T>::PermBatch(size_t count)
+    : degree_(T::fin - T::start + 1), count_(count),
+      tbl_(degree_ * count_) {
+  for (size_t i = 0; i != degree_; ++i)
+    std::fill_n(tbl_.begin() + i * count_, count_, static_cast<uint32_t>(i));
+}
+
+template <typename T>
+template <typename FwdIt>
+PermBatch<T>::PermBatch(FwdIt pbeg, FwdIt pend)
+    : PermBatch(distance(pbeg, pend)) {
+  size_t k = 0;
+  for (auto pit = pbeg; pit != pend; ++pit, ++k)
+    set(k, *pit);
+}
+
+//------------------------------------------------------------------------------
+//
+// Modifiers
+//
+//------------------------------------------------------------------------------
+
+template <typename T>
+template <typename Perm>
+void PermBatch<T>::set(size_t k, const Perm &p) {
+  assert(k < count_);
+  // any permutation applied to id table gives its images
+  vector<T> table(degree_);
+  iota(table.begin(), table.end(), T::start);
+  p.apply(table.begin(), table.end());
+  for (size_t i = 0; i != degree_; ++i)
+    tbl_[i * count_ + k] = table[i] - T::start;
+}
+
+template <typename T>
+void PermBatch<T>::assign_product(const PermBatch<T> &lhs,
+                                  const PermBatch<T> &rhs) {
+  assert(lhs.count_ == rhs.count_);
+  assert(this != &rhs);
+  count_ = lhs.count_;
+  tbl_.resize(degree_ * count_);
+  compose_batch(lhs.tbl_.data(), rhs.tbl_.data(), tbl_.data(), degree_,
+                count_);
+}
+
+template <typename T>
+PermBatch<T> &PermBatch<T>::rmul(const DensePermutation<T> &p) {
+  vector<uint32_t> img(degree_);
+  for (size_t i = 0; i != degree_; ++i)
+    img[i] = p.images()[i] - T::start;
+  rmul_batch(tbl_.data(), img.data(), degree_, count_);
+  return *this;
+}
+
+template <typename T>
+PermBatch<T> &PermBatch<T>::lmul(const DensePermutation<T> &p) {
+  // (p * this)[k](i) = this[k](p(i)), so row i is old row p(i)
+  vector<uint32_t> res(tbl_.size());
+  for (size_t i = 0; i != degree_; ++i) {
+    size_t src = p.images()[i] - T::start;
+    if (count_ != 0)
+      memcpy(&res[i * count_], &tbl_[src * count_],
+             count_ * sizeof(uint32_t));
+  }
+  tbl_.swap(res);
+  return *this;
+}
+
+//------------------------------------------------------------------------------
+//
+// Selectors
+//
+//------------------------------------------------------------------------------
+
+template <typename T> DensePermutation<T> PermBatch<T>::get(size_t k) const {
+  assert(k < count_);
+  vector<T> img(degree_);
+  for (size_t i = 0; i != degree_; ++i)
+    img[i] = static_cast<T>(T::start + tbl_[i * count_ + k]);
+  return DensePermutation<T>(move(img));
+}
+
+} // namespace permutations
+
+#endif
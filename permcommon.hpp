@@ -14,22 +14,33 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <initializer_list>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <list>
 #include <map>
+#include <mutex>
 #include <numeric>
+#include <optional>
 #include <queue>
 #include <random>
 #include <set>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 
+using std::all_of;
 using std::array;
 using std::cerr;
 using std::chrono::duration_cast;
@@ -38,22 +49,31 @@ using std::chrono::steady_clock;
 using std::cout;
 using std::endl;
 using std::exception;
+using std::exception_ptr;
 using std::find;
 using std::forward;
 using std::initializer_list;
+using std::invalid_argument;
 using std::iota;
+using std::lock_guard;
 using std::logic_error;
+using std::make_move_iterator;
 using std::make_pair;
 using std::make_reverse_iterator;
 using std::make_tuple;
 using std::map;
 using std::max;
+using std::min;
 using std::min_element;
 using std::move;
 using std::mt19937;
+using std::mutex;
 using std::next;
+using std::nullopt;
+using std::optional;
 using std::ostream;
 using std::ostream_iterator;
+using std::overflow_error;
 using std::pair;
 using std::prev;
 using std::queue;
@@ -68,6 +88,7 @@ using std::sort;
 using std::string;
 using std::stringstream;
 using std::swap;
+using std::thread;
 using std::transform;
 using std::vector;
 
@@ -92,10 +113,219 @@ auto duration(F &&func, Args &&... args) {
   return duration_cast<milliseconds>(steady_clock::now() - start);
 }
 
-auto mtgen() {
+// well-mixed 64-bit hash of 64-bit value, splitmix64 finalizer
+inline uint64_t mix_hash(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+// hash contribution of single point x with image y, permutation hash is
+// sum of this over all points, so it does not depend on order of visiting
+inline uint64_t point_hash(uint64_t x, uint64_t y) {
+  return mix_hash((x << 32) ^ y);
+}
+
+// lazily calculated hash of immutable-while-shared object, 0 means not yet
+// calculated. Relaxed atomic, so const objects may be hashed from many
+// threads at once: all of them calculate and store the same value
+class HashCache {
+  std::atomic<size_t> h_{0};
+
+public:
+  HashCache() = default;
+  HashCache(const HashCache &rhs) : h_(rhs.get()) {}
+  HashCache &operator=(const HashCache &rhs) {
+    set(rhs.get());
+    return *this;
+  }
+  size_t get() const { return h_.load(std::memory_order_relaxed); }
+  void set(size_t h) { h_.store(h, std::memory_order_relaxed); }
+  void reset() { set(0); }
+};
+
+// persistent worker threads for parallel_for: created on first use, grown
+// on demand and joined at exit, so parallel calls do not spawn threads
+class ThreadPool {
+  vector<thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+
+  // true on pool workers
+  static inline thread_local bool worker_ = false;
+
+public:
+  static ThreadPool &instance() {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  ThreadPool() = default;
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &w : workers_)
+      w.join();
+  }
+
+  // make sure there are at least n workers
+  void reserve(size_t n) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    while (workers_.size() < n)
+      workers_.emplace_back([this] { work(); });
+  }
+
+  void submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      tasks_.push(move(task));
+    }
+    cv_.notify_one();
+  }
+
+  static bool on_worker() { return worker_; }
+
+private:
+  void work() {
+    worker_ = true;
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lk(mtx_);
+        cv_.wait(lk, [this] { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty())
+          return;
+        task = move(tasks_.front());
+        tasks_.pop();
+      }
+      task();
+    }
+  }
+};
+
+// calls func(tid, beg, fin) on nthreads contiguous chunks of [0, n)
+// concurrently, chunk of tid 0 runs on calling thread, others on
+// ThreadPool workers. Nested call from inside of chunk runs all its chunks
+// on calling thread, so workers never wait for each other
+// nthreads == 0 means all hardware threads
+// first exception, thrown by any chunk, is rethrown after all are finished
+template <typename F> void parallel_for(size_t n, size_t nthreads, F &&func) {
+  if (nthreads == 0)
+    nthreads = max<size_t>(1, thread::hardware_concurrency());
+  nthreads = min(nthreads, max<size_t>(n, 1));
+  size_t chunk = (n + nthreads - 1) / nthreads;
+  vector<exception_ptr> errs(nthreads);
+  auto run = [&](size_t tid) {
+    try {
+      func(tid, min(n, tid * chunk), min(n, (tid + 1) * chunk));
+    } catch (...) {
+      errs[tid] = std::current_exception();
+    }
+  };
+
+  if (nthreads == 1 || ThreadPool::on_worker()) {
+    for (size_t tid = 0; tid < nthreads; ++tid)
+      run(tid);
+  } else {
+    std::mutex mtx;
+    std::condition_variable done;
+    size_t left = nthreads - 1;
+    auto &pool = ThreadPool::instance();
+    pool.reserve(nthreads - 1);
+    for (size_t tid = 1; tid < nthreads; ++tid)
+      pool.submit([&, tid] {
+        run(tid);
+        std::lock_guard<std::mutex> lk(mtx);
+        if (--left == 0)
+          done.notify_one();
+      });
+    run(0);
+    std::unique_lock<std::mutex> lk(mtx);
+    done.wait(lk, [&] { return left == 0; });
+  }
+
+  for (auto &e : errs)
+    if (e)
+      std::rethrow_exception(e);
+}
+
+// shared engine for tests and benchmarks, not thread-safe
+inline mt19937 &mtgen() {
   static random_device rd;
   static mt19937 g(rd());
   return g;
 }
 
+// xoshiro256** by Blackman and Vigna, state is seeded through splitmix64
+// jump() advances 2^128 steps, so Xoshiro256(seed, k) for k = 0, 1, ...
+// gives non-overlapping streams, say one per thread
+class Xoshiro256 {
+  uint64_t s_[4];
+
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+  using result_type = uint64_t;
+
+  explicit Xoshiro256(uint64_t seed = 0, uint64_t stream = 0) {
+    for (auto &s : s_) {
+      s = mix_hash(seed);
+      seed += 0x9e3779b97f4a7c15ull;
+    }
+    for (uint64_t k = 0; k != stream; ++k)
+      jump();
+  }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return ~result_type{0}; }
+
+  result_type operator()() {
+    uint64_t res = rotl(s_[1] * 5, 7) * 9;
+    uint64_t t = s_[1] << 17;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = rotl(s_[3], 45);
+    return res;
+  }
+
+  // uniform in [0, n), n > 0
+  uint64_t below(uint64_t n) {
+    uint64_t lim = max() - max() % n;
+    uint64_t x;
+    do
+      x = (*this)();
+    while (x >= lim);
+    return x % n;
+  }
+
+  void jump() {
+    static constexpr uint64_t poly[] = {0x180ec6d33cfd0abaull,
+                                        0xd5a61266f0c9392cull,
+                                        0xa9582618e03fc9aaull,
+                                        0x39abdc4529b1661cull};
+    uint64_t t[4] = {0, 0, 0, 0};
+    for (uint64_t p : poly)
+      for (int b = 0; b != 64; ++b) {
+        if (p & (uint64_t{1} << b))
+          for (int i = 0; i != 4; ++i)
+            t[i] ^= s_[i];
+        (*this)();
+      }
+    for (int i = 0; i != 4; ++i)
+      s_[i] = t[i];
+  }
+};
+
 #endif
@@ -0,0 +1,311 @@
+//------------------------------------------------------------------------------
+//
+//  Dense permutations
+//
+//------------------------------------------------------------------------------
+//
+// DensePermutation<T> stores permutation over domain T as flat image table
+//
+// a b c d e f g
+// c e f b d g a
+//
+// is stored as [c, e, f, b, d, g, a], i.e. img_[x - T::start] is image of x
+//
+// Compared to loop form (see perms.hpp) this gives:
+//   * O(1) point image
+//   * O(n) products and inverse without sorting and rebuilding loops
+//   * single allocation per permutation
+//
+// Interface mirrors Permutation<T>, so both may be used as generators for
+// orbits and Schreier-Sims. Conversion to and from loop form is O(n)
+//
+//------------------------------------------------------------------------------
+
+#ifndef PERMDENSE_GUARD_
+#define PERMDENSE_GUARD_
+
+#include <type_traits>
+
+#include "permcommon.hpp"
+#include "permloops.hpp"
+#include "perms.hpp"
+
+namespace permutations {
+
+//------------------------------------------------------------------------------
+//
+// Dense permutation template
+//
+//------------------------------------------------------------------------------
+
+template <typename T> class DensePermutation {
+  vector<T> img_;
+
+  // cached hash, safe to calculate concurrently on shared permutation
+  mutable HashCache hash_;
+
+  // dependent types
+public:
+  using value_type = T;
+
+  // ctors/dtors
+public:
+  // id permutation over domain
+  DensePermutation();
+
+  // permutation over domain with some initial loops
+  template <typename RandIt> DensePermutation(RandIt ibeg, RandIt ifin);
+
+  DensePermutation(initializer_list<PermLoop<T>> ilist)
+      : DensePermutation(ilist.begin(), ilist.end()) {}
+
+  // from loop form
+  explicit DensePermutation(const Permutation<T> &p);
+
+  // from image table, img[x - T::start] is image of x
+  explicit DensePermutation(vector<T> img);
+
+  // modifiers
+public:
+  // left multiply this = lhs * this
+  DensePermutation &lmul(const DensePermutation &lhs);
+
+  // right multiply this = this * rhs
+  DensePermutation &rmul(const DensePermutation &rhs);
+
+  // inverted permutation
+  DensePermutation &inverse();
+
+  // id permutation for this one
+  DensePermutation id() const { return DensePermutation{}; }
+
+  // selectors
+public:
+  // apply permutation to elem
+  T apply(T elem) const { return img_[elem - T::start]; }
+
+  // apply permutation to given table, same semantics as Permutation::apply
+  template <typename RandIt> void apply(RandIt tbeg, RandIt tend) const;
+
+  // true if permutation contains element
+  bool contains(T elem) const {
+    return (elem >= T::start) && (elem <= T::fin);
+  }
+
+  // smallest element, moved by permutation, id is not allowed
+  T smallest_moved() const;
+
+  // image table
+  const vector<T> &images() const { return img_; }
+
+  // back to loop form
+  Permutation<T> to_loops() const;
+
+  // true if equals, known different hashes give fast answer
+  bool equals(const DensePermutation &rhs) const {
+    size_t h = hash_.get(), rh = rhs.hash_.get();
+    if ((h != 0) && (rh != 0) && (h != rh))
+      return false;
+    return img_ == rhs.img_;
+  }
+
+  // hash, calculated once and cached until modification
+  // equal to hash of the same permutation in loop form
+  size_t hash() const;
+
+  // approximate memory footprint: object and image table
+  size_t bytes() const { return sizeof(*this) + img_.capacity() * sizeof(T); }
+
+  // lexicographical less-than on image tables
+  bool less(const DensePermutation &rhs) const { return img_ < rhs.img_; }
+
+  // dump and serialization
+public:
+  // dump to stream in the same canonical loop form as Permutation
+  void dump(ostream &buffer) const { to_loops().dump(buffer); }
+};
+
+//------------------------------------------------------------------------------
+//
+// Standalone operations
+//
+//------------------------------------------------------------------------------
+
+template <typename T>
+bool operator==(const DensePermutation<T> &lhs,
+                const DensePermutation<T> &rhs) {
+  return lhs.equals(rhs);
+}
+
+template <typename T>
+bool operator<(const DensePermutation<T> &lhs,
+               const DensePermutation<T> &rhs) {
+  return lhs.less(rhs);
+}
+
+template <typename T>
+bool operator!=(const DensePermutation<T> &lhs,
+                const DensePermutation<T> &rhs) {
+  return !operator==(lhs, rhs);
+}
+
+template <typename T>
+static inline ostream &operator<<(ostream &os,
+                                  const DensePermutation<T> &rhs) {
+  rhs.dump(os);
+  return os;
+}
+
+template <typename T>
+DensePermutation<T> product(const DensePermutation<T> &lhs,
+                            const DensePermutation<T> &rhs) {
+  DensePermutation<T> retval = lhs;
+  retval.rmul(rhs);
+  return retval;
+}
+
+template <typename T> DensePermutation<T> invert(DensePermutation<T> lhs) {
+  lhs.inverse();
+  return lhs;
+}
+
+template <typename T>
+DensePermutation<T> perm_pow(const DensePermutation<T> &lhs, long long x) {
+  if (x == 0)
+    return lhs.id();
+  if (x == 1)
+    return lhs;
+  if (x == -1)
+    return invert(lhs);
+  return cycles_pow(lhs, x);
+}
+
+// permutation of any kind from image table, img[x - T::start] is image of x
+template <typename Perm, typename T = typename Perm::value_type>
+Perm perm_from_images(vector<T> img) {
+  DensePermutation<T> d(move(img));
+  if constexpr (std::is_same<Perm, DensePermutation<T>>::value)
+    return d;
+  else if constexpr (std::is_constructible<Perm,
+                                           const DensePermutation<T> &>::value)
+    return Perm(d);
+  else
+    return Perm(d.to_loops());
+}
+
+//------------------------------------------------------------------------------
+//
+// Ctors/dtors
+//
+//------------------------------------------------------------------------------
+
+template <typename T>
+DensePermutation<T>::DensePermutation() : img_(T::fin - T::start + 1) {
+  iota(img_.begin(), img_.end(), T::start);
+}
+
+template <typename T>
+template <typename RandIt>
+DensePermutation<T>::DensePermutation(RandIt ibeg, RandIt ifin)
+    : DensePermutation() {
+  // loops are applied right to left, exactly as in simplify_loops
+  for (auto loopit = make_reverse_iterator(ifin);
+       loopit != make_reverse_iterator(ibeg); ++loopit)
+    loopit->apply(img_.begin(), img_.end());
+}
+
+template <typename T>
+DensePermutation<T>::DensePermutation(const Permutation<T> &p)
+    : DensePermutation() {
+  p.apply(img_.begin(), img_.end());
+}
+
+template <typename T>
+DensePermutation<T>::DensePermutation(vector<T> img) : img_(move(img)) {
+  assert(img_.size() == static_cast<size_t>(T::fin - T::start + 1));
+}
+
+//------------------------------------------------------------------------------
+//
+// Selectors
+//
+//------------------------------------------------------------------------------
+
+template <typename T>
+template <typename RandIt>
+void DensePermutation<T>::apply(RandIt tbeg, RandIt tend) const {
+  assert(static_cast<size_t>(tend - tbeg) == img_.size());
+  vector<typename std::decay<decltype(*tbeg)>::type> tmp(tbeg, tend);
+  for (size_t i = 0, sz = img_.size(); i != sz; ++i)
+    tbeg[i] = tmp[img_[i] - T::start];
+}
+
+template <typename T> T DensePermutation<T>::smallest_moved() const {
+  for (size_t i = 0, sz = img_.size(); i != sz; ++i)
+    if (img_[i] != static_cast<T>(T::start + i))
+      return static_cast<T>(T::start + i);
+  throw logic_error("Id permutation moves nothing");
+}
+
+template <typename T> size_t DensePermutation<T>::hash() const {
+  if (size_t cached = hash_.get(); cached != 0)
+    return cached;
+  uint64_t h = 0;
+  for (size_t i = 0, sz = img_.size(); i != sz; ++i)
+    h += point_hash(i, img_[i] - T::start);
+  // 0 is reserved for not calculated
+  size_t res = (h == 0) ? 1 : static_cast<size_t>(h);
+  hash_.set(res);
+  return res;
+}
+
+template <typename T> Permutation<T> DensePermutation<T>::to_loops() const {
+  vector<PermLoop<T>> loops;
+  create_loops(img_.begin(), img_.end(), back_inserter(loops));
+  return Permutation<T>(loops.begin(), loops.end());
+}
+
+//------------------------------------------------------------------------------
+//
+// Modifiers
+//
+//------------------------------------------------------------------------------
+
+template <typename T>
+DensePermutation<T> &DensePermutation<T>::lmul(const DensePermutation<T> &lhs) {
+  vector<T> res(img_.size());
+  for (size_t i = 0, sz = img_.size(); i != sz; ++i)
+    res[i] = img_[lhs.img_[i] - T::start];
+  img_.swap(res);
+  hash_.reset();
+  return *this;
+}
+
+template <typename T>
+DensePermutation<T> &DensePermutation<T>::rmul(const DensePermutation<T> &rhs) {
+  for (auto &x : img_)
+    x = rhs.img_[x - T::start];
+  hash_.reset();
+  return *this;
+}
+
+template <typename T> DensePermutation<T> &DensePermutation<T>::inverse() {
+  vector<T> res(img_.size());
+  for (size_t i = 0, sz = img_.size(); i != sz; ++i)
+    res[img_[i] - T::start] = static_cast<T>(T::start + i);
+  img_.swap(res);
+  hash_.reset();
+  return *this;
+}
+
+} // namespace permutations
+
+namespace std {
+template <typename T> struct hash<permutations::DensePermutation<T>> {
+  size_t operator()(const permutations::DensePermutation<T> &p) const {
+    return p.hash();
+  }
+};
+} // namespace std
+
+#endif
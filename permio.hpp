@@ -0,0 +1,369 @@
+//------------------------------------------------------------------------------
+//
+//  Streaming input and output of permutations
+//
+//------------------------------------------------------------------------------
+//
+// Two text formats are supported, both for numeric domains:
+//
+// Cycles: GAP-style cycle notation, points separated by commas or blanks
+//
+//   (1,6,3)(2,4)   (1 6 3)(4 2)(5)   ()
+//
+//   Cycles of one permutation may be separated by blanks, but not by line
+//   breaks. Permutations are separated by line breaks or by any of ",;[]",
+//   so GAP lists like [ (1,2), (1,2,3) ] are read as is. Cycles shall be
+//   disjoint, one-point cycles are allowed, so Permutation::dump output
+//   may be read back.
+//
+// Images: image list, i.e. images of T::start, T::start + 1, ... T::fin
+//
+//   [6,4,1,2,5,3]   6 4 1 2 5 3
+//
+//   Either in brackets, or one line of numbers. Permutations are separated
+//   by blanks, line breaks, commas or semicolons.
+//
+// PermReader pulls input in chunks of fixed size and tokenizes it in place,
+// so the only allocation per permutation is the permutation itself. Syntax
+// errors throw invalid_argument with byte offset of the problem.
+//
+// PermWriter formats into its own buffer and passes it to stream in chunks.
+// It always writes one permutation per line, cycles in GAP canonical form:
+// each cycle starts from its smallest point, cycles go by smallest point,
+// fixed points are omitted.
+//
+//------------------------------------------------------------------------------
+
+#ifndef PERMIO_GUARD_
+#define PERMIO_GUARD_
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+
+#include "permcommon.hpp"
+#include "permdense.hpp"
+
+namespace permutations {
+
+enum class PermFormat { Cycles, Images };
+
+//------------------------------------------------------------------------------
+//
+// Reader
+//
+//------------------------------------------------------------------------------
+
+template <typename Perm> class PermReader {
+  using T = typename Perm::value_type;
+
+  std::istream &is_;
+  PermFormat fmt_;
+  vector<char> buf_;
+  size_t pos_ = 0, end_ = 0;
+
+  // bytes before buf_ start
+  size_t offset_ = 0;
+
+  // point x is used in current permutation if stamp_[x] == curstamp_
+  vector<uint32_t> stamp_;
+  uint32_t curstamp_ = 0;
+
+  static constexpr int eof = -1;
+
+public:
+  explicit PermReader(std::istream &is, PermFormat fmt = PermFormat::Cycles,
+                      size_t chunk = 1 << 20);
+
+  // next permutation or nullopt at end of input
+  optional<Perm> next();
+
+  // read everything left, returns number of permutations
+  template <typename OutIt> size_t read_all(OutIt out) {
+    size_t count = 0;
+    for (auto p = next(); p; p = next(), ++count)
+      *out++ = move(*p);
+    return count;
+  }
+
+  // bytes consumed so far
+  size_t position() const { return offset_ + pos_; }
+
+  // service functions
+private:
+  int peek() {
+    if (pos_ == end_ && !refill())
+      return eof;
+    return static_cast<unsigned char>(buf_[pos_]);
+  }
+
+  bool refill();
+
+  [[noreturn]] void fail(const char *msg) const {
+    throw invalid_argument(string("permio: ") + msg + " at byte " +
+                           std::to_string(position()));
+  }
+
+  static bool blank(int c) { return c == ' ' || c == '\t' || c == '\r'; }
+  static bool space(int c) { return blank(c) || c == '\n'; }
+  static bool digit(int c) { return c >= '0' && c <= '9'; }
+
+  void skip(bool (*pred)(int)) {
+    while (pred(peek()))
+      ++pos_;
+  }
+
+  // reads point, checks domain and marks it used in current permutation
+  size_t point();
+
+  void new_stamp();
+  void read_cycles(vector<T> &img);
+  void read_images(vector<T> &img);
+};
+
+//------------------------------------------------------------------------------
+//
+// Writer
+//
+//------------------------------------------------------------------------------
+
+template <typename Perm> class PermWriter {
+  using T = typename Perm::value_type;
+
+  ostream &os_;
+  PermFormat fmt_;
+  size_t chunk_;
+  string buf_;
+  vector<T> img_;
+  vector<char> seen_;
+
+public:
+  explicit PermWriter(ostream &os, PermFormat fmt = PermFormat::Cycles,
+                      size_t chunk = 1 << 20);
+
+  PermWriter(const PermWriter &) = delete;
+  PermWriter &operator=(const PermWriter &) = delete;
+  ~PermWriter() { flush(); }
+
+  // write permutation and line break
+  void write(const Perm &p);
+
+  template <typename FwdIt> void write(FwdIt pbeg, FwdIt pend) {
+    for (auto it = pbeg; it != pend; ++it)
+      write(*it);
+  }
+
+  // pass everything buffered to stream
+  void flush() {
+    os_.write(buf_.data(), buf_.size());
+    buf_.clear();
+  }
+
+  // service functions
+private:
+  void put(T x);
+};
+
+//------------------------------------------------------------------------------
+//
+// Reader implementation
+//
+//------------------------------------------------------------------------------
+
+template <typename Perm>
+PermReader<Perm>::PermReader(std::istream &is, PermFormat fmt, size_t chunk)
+    : is_(is), fmt_(fmt), buf_(max<size_t>(chunk, 1)),
+      stamp_(T::fin - T::start + 1, 0) {}
+
+template <typename Perm> bool PermReader<Perm>::refill() {
+  offset_ += end_;
+  pos_ = end_ = 0;
+  is_.read(buf_.data(), buf_.size());
+  end_ = is_.gcount();
+  return end_ != 0;
+}
+
+template <typename Perm> void PermReader<Perm>::new_stamp() {
+  if (++curstamp_ == 0) {
+    std::fill(stamp_.begin(), stamp_.end(), 0);
+    curstamp_ = 1;
+  }
+}
+
+template <typename Perm> size_t PermReader<Perm>::point() {
+  bool neg = false;
+  if (peek() == '-') {
+    neg = true;
+    ++pos_;
+  }
+  if (!digit(peek()))
+    fail("number expected");
+
+  long long val = 0;
+  for (int c = peek(); digit(c); c = peek()) {
+    if (val > (std::numeric_limits<long long>::max() - 9) / 10)
+      fail("number too big");
+    val = val * 10 + (c - '0');
+    ++pos_;
+  }
+  if (neg)
+    val = -val;
+
+  if (val < static_cast<long long>(T::start) ||
+      val > static_cast<long long>(T::fin))
+    fail("point out of domain");
+  size_t x = val - static_cast<long long>(T::start);
+  if (stamp_[x] == curstamp_)
+    fail("point repeated");
+  stamp_[x] = curstamp_;
+  return x;
+}
+
+template <typename Perm> void PermReader<Perm>::read_cycles(vector<T> &img) {
+  while (peek() == '(') {
+    ++pos_;
+    skip(space);
+    if (peek() == ')') {
+      ++pos_;
+      skip(blank);
+      continue;
+    }
+
+    size_t first = point(), prev = first;
+    for (;;) {
+      skip(space);
+      int c = peek();
+      if (c == ')') {
+        ++pos_;
+        break;
+      }
+      if (c == ',') {
+        ++pos_;
+        skip(space);
+      }
+      size_t x = point();
+      img[prev] = static_cast<T>(T::start + x);
+      prev = x;
+    }
+    img[prev] = static_cast<T>(T::start + first);
+    skip(blank);
+  }
+}
+
+template <typename Perm> void PermReader<Perm>::read_images(vector<T> &img) {
+  bool bracket = (peek() == '[');
+  if (bracket)
+    ++pos_;
+
+  size_t n = img.size(), i = 0;
+  for (;;) {
+    skip(bracket ? space : blank);
+    int c = peek();
+    if (bracket && c == ']') {
+      ++pos_;
+      break;
+    }
+    if (!bracket && (c == '\n' || c == eof))
+      break;
+    if (i != 0 && c == ',') {
+      ++pos_;
+      skip(bracket ? space : blank);
+    }
+    if (i == n)
+      fail("too many images");
+    img[i++] = static_cast<T>(T::start + point());
+  }
+
+  if (i != n)
+    fail("too few images");
+}
+
+template <typename Perm> optional<Perm> PermReader<Perm>::next() {
+  const char *seps = (fmt_ == PermFormat::Cycles) ? ",;[]" : ",;";
+  for (int c = peek(); c != eof; c = peek()) {
+    if (!space(c) && !strchr(seps, c))
+      break;
+    ++pos_;
+  }
+  if (peek() == eof)
+    return nullopt;
+
+  vector<T> img(stamp_.size());
+  iota(img.begin(), img.end(), T::start);
+  new_stamp();
+
+  if (fmt_ == PermFormat::Cycles) {
+    if (peek() != '(')
+      fail("cycle expected");
+    read_cycles(img);
+  } else {
+    read_images(img);
+  }
+  return perm_from_images<Perm>(move(img));
+}
+
+//------------------------------------------------------------------------------
+//
+// Writer implementation
+//
+//------------------------------------------------------------------------------
+
+template <typename Perm>
+PermWriter<Perm>::PermWriter(ostream &os, PermFormat fmt, size_t chunk)
+    : os_(os), fmt_(fmt), chunk_(chunk), img_(T::fin - T::start + 1),
+      seen_(img_.size()) {
+  buf_.reserve(chunk_ + 64);
+}
+
+template <typename Perm> void PermWriter<Perm>::put(T x) {
+  char tmp[24];
+  auto res = std::to_chars(tmp, tmp + sizeof(tmp),
+                           static_cast<long long>(x));
+  buf_.append(tmp, res.ptr);
+}
+
+template <typename Perm> void PermWriter<Perm>::write(const Perm &p) {
+  size_t n = img_.size();
+  for (size_t i = 0; i != n; ++i)
+    img_[i] = p.apply(static_cast<T>(T::start + i));
+
+  if (fmt_ == PermFormat::Images) {
+    buf_ += '[';
+    for (size_t i = 0; i != n; ++i) {
+      if (i != 0)
+        buf_ += ',';
+      put(img_[i]);
+    }
+    buf_ += ']';
+  } else {
+    std::fill(seen_.begin(), seen_.end(), 0);
+    bool any = false;
+    for (size_t i = 0; i != n; ++i) {
+      if (seen_[i] || img_[i] == static_cast<T>(T::start + i))
+        continue;
+      any = true;
+      buf_ += '(';
+      size_t x = i;
+      do {
+        seen_[x] = 1;
+        if (x != i)
+          buf_ += ',';
+        put(static_cast<T>(T::start + x));
+        x = img_[x] - T::start;
+      } while (x != i);
+      buf_ += ')';
+    }
+    if (!any)
+      buf_ += "()";
+  }
+  buf_ += '\n';
+
+  if (buf_.size() >= chunk_)
+    flush();
+}
+
+} // namespace permutations
+
+#endif
@@ -66,6 +66,9 @@ public:
   // get smallest element in loop
   T smallest() const { return loop_.front(); }
 
+  // approximate memory footprint: object and its heap storage
+  size_t bytes() const { return sizeof(*this) + loop_.capacity() * sizeof(T); }
+
   // if loop is primitive e.g. like (5)
   bool is_primitive() const { return loop_.size() < 2; }
 
@@ -98,6 +101,10 @@ public:
   // size of loop
   size_t size() const { return loop_.size(); }
 
+  // iterators on elements, starting from smallest one
+  auto begin() const { return loop_.begin(); }
+  auto end() const { return loop_.end(); }
+
   // Serialization and dumps
 public:
   // dump to given stream
@@ -0,0 +1,373 @@
+//------------------------------------------------------------------------------
+//
+//  Packed permutations
+//
+//------------------------------------------------------------------------------
+//
+// PackedPermutation<T> is image table for domains of at most 32 points,
+// stored as zero-based bytes in one (up to 16 points) or two (up to 32 points)
+// 128-bit words. Unused tail bytes always keep identity.
+//
+// Product of packed permutations is byte shuffle: if a[i] is image of i then
+// (a * b)[i] = b[a[i]], which is exactly pshufb(b, a). With SSSE3 enabled
+// (say -mssse3 or -march=native) products are done in registers, otherwise
+// plain loop over bytes is used.
+//
+// FastPermutation<T> picks PackedPermutation<T> for small domains and
+// DensePermutation<T> otherwise, at compile time from T::start and T::fin.
+// Domains with runtime bounds (T::runtime is true) always get dense one
+//
+//------------------------------------------------------------------------------
+
+#ifndef PERMPACKED_GUARD_
+#define PERMPACKED_GUARD_
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+#include "permcommon.hpp"
+#include "permdense.hpp"
+#include "permloops.hpp"
+#include "perms.hpp"
+
+namespace permutations {
+
+// maximum number of points packed permutation can handle
+constexpr size_t packed_max_degree = 32;
+
+template <typename T> constexpr size_t domain_degree() {
+  return static_cast<size_t>(T::fin - T::start + 1);
+}
+
+// true if domain bounds are known at compile time
+template <typename T, typename = void> struct static_domain : std::true_type {};
+
+template <typename T>
+struct static_domain<T, std::void_t<decltype(T::runtime)>>
+    : std::integral_constant<bool, !T::runtime> {};
+
+//------------------------------------------------------------------------------
+//
+// Packed permutation template
+//
+//------------------------------------------------------------------------------
+
+template <typename T> class PackedPermutation {
+  static constexpr size_t degree_ = domain_degree<T>();
+  static_assert(degree_ <= packed_max_degree,
+                "Domain too large for packed permutation");
+  static constexpr size_t width_ = (degree_ <= 16) ? 16 : 32;
+
+  alignas(16) uint8_t img_[width_];
+
+  // dependent types
+public:
+  using value_type = T;
+
+  // ctors/dtors
+public:
+  // id permutation over domain
+  PackedPermutation() {
+    for (size_t i = 0; i != width_; ++i)
+      img_[i] = static_cast<uint8_t>(i);
+  }
+
+  // permutation over domain with some initial loops
+  template <typename RandIt> PackedPermutation(RandIt ibeg, RandIt ifin);
+
+  PackedPermutation(initializer_list<PermLoop<T>> ilist)
+      : PackedPermutation(ilist.begin(), ilist.end()) {}
+
+  // from loop form
+  explicit PackedPermutation(const Permutation<T> &p);
+
+  // from dense form
+  explicit PackedPermutation(const DensePermutation<T> &p);
+
+  // modifiers
+public:
+  // left multiply this = lhs * this
+  PackedPermutation &lmul(const PackedPermutation &lhs) {
+    shuffle(img_, lhs.img_, img_);
+    return *this;
+  }
+
+  // right multiply this = this * rhs
+  PackedPermutation &rmul(const PackedPermutation &rhs) {
+    shuffle(img_, img_, rhs.img_);
+    return *this;
+  }
+
+  // inverted permutation
+  PackedPermutation &inverse();
+
+  // id permutation for this one
+  PackedPermutation id() const { return PackedPermutation{}; }
+
+  // selectors
+public:
+  // apply permutation to elem
+  T apply(T elem) const {
+    return static_cast<T>(T::start + img_[elem - T::start]);
+  }
+
+  // apply permutation to given table, same semantics as Permutation::apply
+  template <typename RandIt> void apply(RandIt tbeg, RandIt tend) const;
+
+  // true if permutation contains element
+  bool contains(T elem) const {
+    return (elem >= T::start) && (elem <= T::fin);
+  }
+
+  // smallest element, moved by permutation, id is not allowed
+  T smallest_moved() const;
+
+  // back to loop form
+  Permutation<T> to_loops() const { return to_dense().to_loops(); }
+
+  // to dense form
+  DensePermutation<T> to_dense() const;
+
+  // true if equals
+  bool equals(const PackedPermutation &rhs) const;
+
+  // lexicographical less-than on image tables
+  bool less(const PackedPermutation &rhs) const {
+    return memcmp(img_, rhs.img_, width_) < 0;
+  }
+
+  // hash of packed bytes
+  size_t hash() const;
+
+  // memory footprint, nothing on heap
+  size_t bytes() const { return sizeof(*this); }
+
+  // dump and serialization
+public:
+  // dump to stream in the same canonical loop form as Permutation
+  void dump(ostream &buffer) const { to_loops().dump(buffer); }
+
+  // service functions
+private:
+  // res[i] = b[a[i]], res may alias a or b
+  static void shuffle(uint8_t *res, const uint8_t *a, const uint8_t *b);
+};
+
+// packed permutation for small domains, dense otherwise
+template <typename T>
+using FastPermutation =
+    typename std::conditional<(static_domain<T>::value &&
+                               domain_degree<T>() <= packed_max_degree),
+                              PackedPermutation<T>,
+                              DensePermutation<T>>::type;
+
+//------------------------------------------------------------------------------
+//
+// Standalone operations
+//
+//------------------------------------------------------------------------------
+
+template <typename T>
+bool operator==(const PackedPermutation<T> &lhs,
+                const PackedPermutation<T> &rhs) {
+  return lhs.equals(rhs);
+}
+
+template <typename T>
+bool operator<(const PackedPermutation<T> &lhs,
+               const PackedPermutation<T> &rhs) {
+  return lhs.less(rhs);
+}
+
+template <typename T>
+bool operator!=(const PackedPermutation<T> &lhs,
+                const PackedPermutation<T> &rhs) {
+  return !operator==(lhs, rhs);
+}
+
+template <typename T>
+static inline ostream &operator<<(ostream &os,
+                                  const PackedPermutation<T> &rhs) {
+  rhs.dump(os);
+  return os;
+}
+
+template <typename T>
+PackedPermutation<T> product(const PackedPermutation<T> &lhs,
+                             const PackedPermutation<T> &rhs) {
+  PackedPermutation<T> retval = lhs;
+  retval.rmul(rhs);
+  return retval;
+}
+
+template <typename T> PackedPermutation<T> invert(PackedPermutation<T> lhs) {
+  lhs.inverse();
+  return lhs;
+}
+
+template <typename T>
+PackedPermutation<T> perm_pow(const PackedPermutation<T> &lhs, long long x) {
+  if (x == 0)
+    return lhs.id();
+  if (x == 1)
+    return lhs;
+  if (x == -1)
+    return invert(lhs);
+  return cycles_pow(lhs, x);
+}
+
+//------------------------------------------------------------------------------
+//
+// Ctors/dtors
+//
+//------------------------------------------------------------------------------
+
+template <typename T>
+template <typename RandIt>
+PackedPermutation<T>::PackedPermutation(RandIt ibeg, RandIt ifin)
+    : PackedPermutation(DensePermutation<T>(ibeg, ifin)) {}
+
+template <typename T>
+PackedPermutation<T>::PackedPermutation(const Permutation<T> &p)
+    : PackedPermutation(DensePermutation<T>(p)) {}
+
+template <typename T>
+PackedPermutation<T>::PackedPermutation(const DensePermutation<T> &p)
+    : PackedPermutation() {
+  const auto &img = p.images();
+  for (size_t i = 0; i != degree_; ++i)
+    img_[i] = static_cast<uint8_t>(img[i] - T::start);
+}
+
+//------------------------------------------------------------------------------
+//
+// Selectors
+//
+//------------------------------------------------------------------------------
+
+template <typename T>
+template <typename RandIt>
+void PackedPermutation<T>::apply(RandIt tbeg, RandIt tend) const {
+  assert(static_cast<size_t>(tend - tbeg) == degree_);
+  vector<typename std::decay<decltype(*tbeg)>::type> tmp(tbeg, tend);
+  for (size_t i = 0; i != degree_; ++i)
+    tbeg[i] = tmp[img_[i]];
+}
+
+template <typename T> T PackedPermutation<T>::smallest_moved() const {
+  for (size_t i = 0; i != degree_; ++i)
+    if (img_[i] != i)
+      return static_cast<T>(T::start + i);
+  throw logic_error("Id permutation moves nothing");
+}
+
+template <typename T>
+DensePermutation<T> PackedPermutation<T>::to_dense() const {
+  vector<T> img(degree_);
+  for (size_t i = 0; i != degree_; ++i)
+    img[i] = static_cast<T>(T::start + img_[i]);
+  return DensePermutation<T>(move(img));
+}
+
+template <typename T>
+bool PackedPermutation<T>::equals(const PackedPermutation<T> &rhs) const {
+#if defined(__SSSE3__)
+  for (size_t i = 0; i != width_; i += 16) {
+    __m128i a = _mm_load_si128(reinterpret_cast<const __m128i *>(img_ + i));
+    __m128i b =
+        _mm_load_si128(reinterpret_cast<const __m128i *>(rhs.img_ + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+      return false;
+  }
+  return true;
+#else
+  return memcmp(img_, rhs.img_, width_) == 0;
+#endif
+}
+
+template <typename T> size_t PackedPermutation<T>::hash() const {
+  uint64_t h = 0x9e3779b97f4a7c15ull;
+  for (size_t i = 0; i != width_; i += 8) {
+    uint64_t w;
+    memcpy(&w, img_ + i, 8);
+    h ^= w + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 31;
+  }
+  return static_cast<size_t>(h);
+}
+
+//------------------------------------------------------------------------------
+//
+// Modifiers
+//
+//------------------------------------------------------------------------------
+
+template <typename T> PackedPermutation<T> &PackedPermutation<T>::inverse() {
+  alignas(16) uint8_t res[width_];
+  for (size_t i = 0; i != width_; ++i)
+    res[img_[i]] = static_cast<uint8_t>(i);
+  memcpy(img_, res, width_);
+  return *this;
+}
+
+//------------------------------------------------------------------------------
+//
+// Service functions
+//
+//------------------------------------------------------------------------------
+
+template <typename T>
+void PackedPermutation<T>::shuffle(uint8_t *res, const uint8_t *a,
+                                   const uint8_t *b) {
+#if defined(__SSSE3__)
+  if constexpr (width_ == 16) {
+    __m128i va = _mm_load_si128(reinterpret_cast<const __m128i *>(a));
+    __m128i vb = _mm_load_si128(reinterpret_cast<const __m128i *>(b));
+    _mm_store_si128(reinterpret_cast<__m128i *>(res),
+                    _mm_shuffle_epi8(vb, va));
+    return;
+  }
+
+  // 32 points: indices below 16 pick from low half of b, others from high
+  // half. pshufb zeroes lanes with high bit set in index, so each half is
+  // shuffled with lanes of other half masked out, then both are combined.
+  // For high half, index - 16 is negative exactly for low half lanes
+  __m128i blo = _mm_load_si128(reinterpret_cast<const __m128i *>(b));
+  __m128i bhi = _mm_load_si128(reinterpret_cast<const __m128i *>(b + 16));
+  __m128i a0 = _mm_load_si128(reinterpret_cast<const __m128i *>(a));
+  __m128i a1 = _mm_load_si128(reinterpret_cast<const __m128i *>(a + 16));
+  __m128i fifteen = _mm_set1_epi8(15);
+  __m128i sixteen = _mm_set1_epi8(16);
+  __m128i m0 = _mm_cmpgt_epi8(a0, fifteen);
+  __m128i m1 = _mm_cmpgt_epi8(a1, fifteen);
+  __m128i r0 = _mm_or_si128(_mm_shuffle_epi8(blo, _mm_or_si128(a0, m0)),
+                            _mm_shuffle_epi8(bhi, _mm_sub_epi8(a0, sixteen)));
+  __m128i r1 = _mm_or_si128(_mm_shuffle_epi8(blo, _mm_or_si128(a1, m1)),
+                            _mm_shuffle_epi8(bhi, _mm_sub_epi8(a1, sixteen)));
+  _mm_store_si128(reinterpret_cast<__m128i *>(res), r0);
+  _mm_store_si128(reinterpret_cast<__m128i *>(res + 16), r1);
+#else
+  alignas(16) uint8_t tmp[width_];
+  for (size_t i = 0; i != width_; ++i)
+    tmp[i] = b[a[i]];
+  memcpy(res, tmp, width_);
+#endif
+}
+
+} // namespace permutations
+
+namespace std {
+template <typename T> struct hash<permutations::PackedPermutation<T>> {
+  size_t operator()(const permutations::PackedPermutation<T> &p) const {
+    return p.hash();
+  }
+};
+} // namespace std
+
+#endif
@@ -42,6 +42,9 @@ namespace permutations {
 template <typename T> class Permutation {
   vector<PermLoop<T>> loops_;
 
+  // cached hash, safe to calculate concurrently on shared permutation
+  mutable HashCache hash_;
+
   // dependent types
 public:
   using value_type = T;
@@ -69,18 +72,20 @@ public:
   Permutation &inverse() {
     for (auto &l : loops_)
       l.inverse();
+    hash_.reset();
     return *this;
   }
 
   // id permutation for this one
   Permutation id() const { return Permutation{}; }
 
-  // iterators on internal strucrure
+  // iterators on internal strucrure, read-only: loops are changed only by
+  // modifiers above, so cached hash can not go stale
 public:
-  auto begin() { return loops_.begin(); }
-  auto end() { return loops_.end(); }
-  auto rbegin() { return loops_.rbegin(); }
-  auto rend() { return loops_.rend(); }
+  auto begin() const { return loops_.cbegin(); }
+  auto end() const { return loops_.cend(); }
+  auto rbegin() const { return loops_.crbegin(); }
+  auto rend() const { return loops_.crend(); }
 
   // selectors
 public:
@@ -96,8 +101,29 @@ public:
   // true if permutation contains element
   bool contains(T elem) const;
 
-  // true if equals
-  bool equals(const Permutation &rhs) const { return rhs.loops_ == loops_; }
+  // smallest element, moved by permutation, id is not allowed
+  T smallest_moved() const;
+
+  // true if equals, known different hashes give fast answer
+  bool equals(const Permutation &rhs) const {
+    size_t h = hash_.get(), rh = rhs.hash_.get();
+    if ((h != 0) && (rh != 0) && (h != rh))
+      return false;
+    return rhs.loops_ == loops_;
+  }
+
+  // hash, calculated once and cached until modification
+  // equal permutations of any form have equal hashes, except packed one
+  size_t hash() const;
+
+  // approximate memory footprint: object, loops table and every loop
+  size_t bytes() const {
+    size_t res = sizeof(*this) +
+                 (loops_.capacity() - loops_.size()) * sizeof(PermLoop<T>);
+    for (auto &&l : loops_)
+      res += l.bytes();
+    return res;
+  }
 
   // lexicographical less-than
   bool less(const Permutation &rhs) const {
@@ -163,25 +189,186 @@ template <typename T> Permutation<T> invert(Permutation<T> lhs) {
   return lhs;
 }
 
+//------------------------------------------------------------------------------
+//
+// Cycle arithmetic
+//
+// Powers, orders and roots are computed from disjoint cycles directly, in
+// O(n) regardless of exponent. Works for any permutation type with apply and
+// construction from loops range (Permutation, DensePermutation, etc)
+//
+//------------------------------------------------------------------------------
+
+// disjoint cycles of permutation, including fixed points
+template <typename Perm> auto perm_cycles(const Perm &p) {
+  using T = typename Perm::value_type;
+  vector<vector<T>> cycles;
+  vector<bool> marked(T::fin - T::start + 1, false);
+  for (auto x = T::start; x <= T::fin; ++x) {
+    if (marked[x - T::start])
+      continue;
+    vector<T> c;
+    for (T y = x; !marked[y - T::start]; y = p.apply(y)) {
+      marked[y - T::start] = true;
+      c.push_back(y);
+    }
+    cycles.push_back(move(c));
+  }
+  return cycles;
+}
+
+// loop form already has its cycles
+template <typename T> auto perm_cycles(const Permutation<T> &p) {
+  vector<vector<T>> cycles;
+  for (auto &&l : p)
+    cycles.emplace_back(l.begin(), l.end());
+  return cycles;
+}
+
+// cycle type as {length => number of cycles of this length}
+template <typename Perm> map<size_t, size_t> cycle_type(const Perm &p) {
+  map<size_t, size_t> ctype;
+  for (auto &&c : perm_cycles(p))
+    ctype[c.size()] += 1;
+  return ctype;
+}
+
+// order of permutation as {prime => power}, i.e. factored lcm of cycle
+// lengths. Never overflows, id gives empty map
+template <typename Perm>
+map<size_t, size_t> perm_order_factors(const Perm &p) {
+  map<size_t, size_t> factors;
+  for (auto &&lc : cycle_type(p)) {
+    size_t len = lc.first;
+    for (size_t d = 2; d * d <= len; ++d) {
+      size_t pw = 0;
+      for (; len % d == 0; len /= d)
+        pw += 1;
+      if (pw > 0)
+        factors[d] = max(factors[d], pw);
+    }
+    if (len > 1)
+      factors[len] = max<size_t>(factors[len], 1);
+  }
+  return factors;
+}
+
+// order of permutation, throws overflow_error if it does not fit
+template <typename Perm> unsigned long long perm_order(const Perm &p) {
+  const auto maxval = std::numeric_limits<unsigned long long>::max();
+  unsigned long long ord = 1;
+  for (auto &&f : perm_order_factors(p))
+    for (size_t n = 0; n < f.second; ++n) {
+      if (ord > maxval / f.first)
+        throw overflow_error("permutation order does not fit");
+      ord *= f.first;
+    }
+  return ord;
+}
+
+// order of permutation as decimal string, any size
+template <typename Perm> string perm_order_decimal(const Perm &p) {
+  // little-endian digits in base 10^9
+  const unsigned long long base = 1000000000ull;
+  vector<unsigned long long> digits{1};
+  for (auto &&f : perm_order_factors(p))
+    for (size_t n = 0; n < f.second; ++n) {
+      unsigned long long carry = 0;
+      for (auto &d : digits) {
+        unsigned long long cur = d * f.first + carry;
+        d = cur % base;
+        carry = cur / base;
+      }
+      for (; carry != 0; carry /= base)
+        digits.push_back(carry % base);
+    }
+  stringstream buffer;
+  buffer << digits.back();
+  for (auto it = next(digits.rbegin()); it != digits.rend(); ++it)
+    buffer << std::setw(9) << std::setfill('0') << *it;
+  return buffer.str();
+}
+
+// x-th power by rotation inside every cycle
+template <typename Perm> Perm cycles_pow(const Perm &p, long long x) {
+  using T = typename Perm::value_type;
+  vector<PermLoop<T>> loops;
+  for (auto &&c : perm_cycles(p)) {
+    long long len = c.size();
+    size_t k = ((x % len) + len) % len;
+    if (k == 0)
+      continue;
+    // cycle of length len splits to gcd(len, k) cycles
+    size_t ncycles = std::gcd(static_cast<size_t>(len), k);
+    size_t clen = len / ncycles;
+    for (size_t start = 0; start < ncycles; ++start) {
+      vector<T> loop;
+      for (size_t n = 0, pos = start; n < clen; ++n, pos = (pos + k) % len)
+        loop.push_back(c[pos]);
+      loops.emplace_back(loop.begin(), loop.end());
+    }
+  }
+  return Perm(loops.begin(), loops.end());
+}
+
+// some r such that r^k = p or nullopt if there is no such r
+template <typename Perm> optional<Perm> perm_root(const Perm &p, long long k) {
+  using T = typename Perm::value_type;
+  if (k == 0) {
+    if (p == p.id())
+      return p.id();
+    return nullopt;
+  }
+  if (k < 0) {
+    auto pinv = p;
+    pinv.inverse();
+    return perm_root(pinv, -k);
+  }
+
+  map<size_t, vector<vector<T>>> bylen;
+  for (auto &&c : perm_cycles(p))
+    bylen[c.size()].push_back(move(c));
+
+  vector<PermLoop<T>> loops;
+  for (auto &&lc : bylen) {
+    size_t m = lc.first;
+    auto &cycles = lc.second;
+
+    // cycle of length m * g in r gives g cycles of length m in r^k exactly
+    // when gcd(m, k / g) = 1. Smallest such g takes all primes of gcd(m, k)
+    // to their full power in k and divides every other one
+    unsigned long long g = 1, rest = k;
+    for (auto d = std::gcd<unsigned long long>(rest, m); d > 1;
+         d = std::gcd<unsigned long long>(rest, m)) {
+      g *= d;
+      rest /= d;
+    }
+    if (cycles.size() % g != 0)
+      return nullopt;
+
+    // interleave g cycles c_0 .. c_{g-1}: r[(i + t * k) mod L] = c_i[t]
+    size_t len = m * g;
+    size_t kmod = k % len;
+    for (size_t first = 0; first < cycles.size(); first += g) {
+      vector<T> loop(len);
+      for (size_t i = 0; i < g; ++i)
+        for (size_t t = 0, pos = i; t < m; ++t, pos = (pos + kmod) % len)
+          loop[pos] = cycles[first + i][t];
+      loops.emplace_back(loop.begin(), loop.end());
+    }
+  }
+  return Perm(loops.begin(), loops.end());
+}
+
 template <typename T>
-Permutation<T> perm_pow(const Permutation<T> &lhs, int x) {
-  Permutation<T> res;
+Permutation<T> perm_pow(const Permutation<T> &lhs, long long x) {
   if (x == 0)
-    return res;
+    return Permutation<T>{};
   if (x == 1)
     return lhs;
   if (x == -1)
     return invert(lhs);
-
-  int xval = (x > 0) ? x : -x;
-  // TODO: I can raise in power better
-  for (int n = 0; n < xval; ++n)
-    res.rmul(lhs);
-
-  if (x != xval)
-    res.inverse();
-
-  return res;
+  return cycles_pow(lhs, x);
 }
 
 //------------------------------------------------------------------------------
@@ -229,6 +416,33 @@ template <typename T> bool Permutation<T>::contains(T elem) const {
   return (it != loops_.end());
 }
 
+template <typename T> T Permutation<T>::smallest_moved() const {
+  // loops are sorted by first element in decreasing order
+  auto it = find_if(loops_.rbegin(), loops_.rend(),
+                    [](const PermLoop<T> &pl) { return !pl.is_primitive(); });
+  if (it == loops_.rend())
+    throw logic_error("Id permutation moves nothing");
+  return it->smallest();
+}
+
+template <typename T> size_t Permutation<T>::hash() const {
+  if (size_t cached = hash_.get(); cached != 0)
+    return cached;
+  uint64_t h = 0;
+  for (auto &&l : loops_) {
+    auto first = l.begin();
+    for (auto it = first; it != l.end(); ++it) {
+      auto nxt = next(it);
+      T img = (nxt == l.end()) ? *first : *nxt;
+      h += point_hash(*it - T::start, img - T::start);
+    }
+  }
+  // 0 is reserved for not calculated
+  size_t res = (h == 0) ? 1 : static_cast<size_t>(h);
+  hash_.set(res);
+  return res;
+}
+
 template <typename T> void Permutation<T>::dump(ostream &os) const {
   for (auto l : loops_)
     l.dump(os);
@@ -247,6 +461,7 @@ Permutation<T> &Permutation<T>::lmul(const Permutation<T> &input) {
   simplify_loops(loops_.begin(), loops_.end(), back_inserter(outloops));
   loops_.swap(outloops);
   sortloops();
+  hash_.reset();
 #ifdef CHECKS
   check();
 #endif
@@ -260,6 +475,7 @@ Permutation<T> &Permutation<T>::rmul(const Permutation<T> &input) {
   simplify_loops(loops_.begin(), loops_.end(), back_inserter(outloops));
   loops_.swap(outloops);
   sortloops();
+  hash_.reset();
 #ifdef CHECKS
   check();
 #endif
@@ -300,4 +516,12 @@ template <typename T> void Permutation<T>::sortloops() {
 
 } // namespace permutations
 
+namespace std {
+template <typename T> struct hash<permutations::Permutation<T>> {
+  size_t operator()(const permutations::Permutation<T> &p) const {
+    return p.hash();
+  }
+};
+} // namespace std
+
 #endif
@@ -6,8 +6,13 @@
 
 #include <iterator>
 
+#include "flathash.hpp"
 #include "idomain.hpp"
+#include "permbatch.hpp"
+#include "permdense.hpp"
+#include "permio.hpp"
 #include "permloops.hpp"
+#include "permpacked.hpp"
 #include "perms.hpp"
 
 using namespace permutations;
@@ -233,6 +238,419 @@ int test_powers() {
   simple_check(g2 == perm_pow(g1, -3));
   simple_check(g1 == perm_pow(g1, -4));
 
+  // big exponents are reduced per cycle
+  Permutation<UD5> h{{1, 2}, {3, 4, 5}};
+  simple_check(perm_pow(h, 1000000) == perm_pow(h, 1000000 % 6));
+  simple_check(perm_pow(h, -1000001) == perm_pow(h, 1));
+  Permutation<UD5> h3{{1, 2}}, h2{{3, 5, 4}};
+  simple_check(perm_pow(h, 3) == h3);
+  simple_check(perm_pow(h, 2) == h2);
+  simple_check(perm_pow(DensePermutation<UD5>{h}, 4) ==
+               DensePermutation<UD5>{perm_pow(h, 4)});
+  simple_check(perm_pow(PackedPermutation<UD5>{h}, -5) ==
+               PackedPermutation<UD5>{perm_pow(h, -5)});
+
+  // splitting cycle of length 6 by power 4 gives two 3-cycles
+  using UD6 = UnsignedDomain<1, 6>;
+  Permutation<UD6> c6{{1, 2, 3, 4, 5, 6}};
+  Permutation<UD6> c33({{1, 5, 3}, {2, 6, 4}});
+  simple_check(perm_pow(c6, 4) == c33);
+
+  // orders and cycle types
+  map<size_t, size_t> ct = {{2, 1}, {3, 1}};
+  simple_check(cycle_type(h) == ct);
+  simple_check(perm_order(h) == 6);
+  simple_check(perm_order(e) == 1);
+  simple_check(perm_order(DensePermutation<UD5>{h}) == 6);
+  simple_check(perm_order_decimal(h) == "6");
+
+  // lcm of prime cycle lengths 2, 3, 5, .., 47 still fits 64 bits, but
+  // adding 53 to them does not
+  using UDB = UnsignedDomain<1, 400>;
+  vector<PermLoop<UDB>> bigloops;
+  unsigned first = 1;
+  for (unsigned p : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47}) {
+    vector<UDB> l(p);
+    iota(l.begin(), l.end(), first);
+    bigloops.emplace_back(l.begin(), l.end());
+    first += p;
+  }
+  DensePermutation<UDB> big(bigloops.begin(), bigloops.end());
+  simple_check(perm_order(big) == 614889782588491410ull);
+  simple_check(perm_order_decimal(big) == "614889782588491410");
+
+  vector<UDB> l53(53);
+  iota(l53.begin(), l53.end(), first);
+  bigloops.emplace_back(l53.begin(), l53.end());
+  DensePermutation<UDB> bigger(bigloops.begin(), bigloops.end());
+  simple_check(perm_order_decimal(bigger) == "32589158477190044730");
+  bool thrown = false;
+  try {
+    perm_order(bigger);
+  } catch (overflow_error &) {
+    thrown = true;
+  }
+  simple_check(thrown);
+
+  // roots
+  Permutation<UD5> t{{1, 2}, {3, 4}};
+  auto rt = perm_root(t, 2);
+  simple_check(rt && perm_pow(*rt, 2) == t);
+  simple_check(!perm_root(h3, 2));
+  simple_check(*perm_root(g1, 1) == g1);
+  auto r3 = perm_root(g1, 3);
+  simple_check(r3 && perm_pow(*r3, 3) == g1);
+  auto rneg = perm_root(h, -5);
+  simple_check(rneg && perm_pow(*rneg, -5) == h);
+  auto rc = perm_root(c33, 4);
+  simple_check(rc && perm_pow(*rc, 4) == c33);
+  DensePermutation<UD6> d222{{1, 2}, {3, 4}, {5, 6}};
+  auto rd = perm_root(d222, 6);
+  simple_check(!rd);
+
+  return 0;
+}
+
+int test_dense_perms() {
+  cout << "Dense perm tests" << endl;
+  using UD5 = UnsignedDomain<1, 5>;
+  using DP = DensePermutation<UD5>;
+
+  DP e;
+  Permutation<UD5> lg3{{1, 2}, {3, 4, 5}};
+  DP g3{{1, 2}, {3, 4, 5}};
+  simple_check(g3 == DP{lg3});
+  simple_check(g3.to_loops() == lg3);
+  simple_check(e.to_loops() == Permutation<UD5>{});
+  simple_check(g3.apply(1) == 2);
+  simple_check(g3.apply(5) == 3);
+  simple_check(g3.smallest_moved() == 1);
+
+  vector<UD5> initial{1, 2, 3, 4, 5};
+  vector<UD5> permuted{2, 1, 4, 5, 3};
+  auto v = initial;
+  g3.apply(v.begin(), v.end());
+  simple_check(v == permuted);
+
+  auto g3inv = invert(g3);
+  simple_check(product(g3, g3inv) == e);
+  simple_check(product(g3inv, g3) == e);
+  simple_check(g3inv.to_loops() == invert(lg3));
+
+  // products shall agree with loop form in both directions
+  Permutation<UD5> lg4({{1, 2, 3}, {4, 5}});
+  Permutation<UD5> lg5({{1, 3}, {2, 4, 5}});
+  DP g4{lg4}, g5{lg5};
+  simple_check(product(g3, g4).to_loops() == product(lg3, lg4));
+  simple_check(product(g4, g5).to_loops() == product(lg4, lg5));
+  auto l45 = g5;
+  l45.lmul(g4);
+  simple_check(l45 == product(g4, g5));
+
+  DP g6{{2, 4, 5, 3}};
+  simple_check(g6.smallest_moved() == 2);
+  simple_check(perm_pow(g6, 4) == e);
+  simple_check(perm_pow(g6, -1) == invert(g6));
+
+  stringstream dense, loops;
+  dense << g3;
+  loops << lg3;
+  simple_check(dense.str() == loops.str());
+
+  return 0;
+}
+
+// packed products shall agree with dense ones on random permutations
+template <typename T> void check_packed_vs_dense(size_t nrounds) {
+  using DP = DensePermutation<T>;
+  using PP = PackedPermutation<T>;
+  static_assert(std::is_same<FastPermutation<T>, PP>::value,
+                "small domain shall pick packed permutation");
+  mt19937 g(42);
+  vector<T> img(T::fin - T::start + 1);
+  auto randperm = [&]() {
+    iota(img.begin(), img.end(), T::start);
+    std::shuffle(img.begin(), img.end(), g);
+    return DP(img);
+  };
+
+  for (size_t n = 0; n < nrounds; ++n) {
+    DP a = randperm(), b = randperm();
+    PP pa{a}, pb{b};
+    simple_check(pa.to_dense() == a);
+    simple_check(product(pa, pb).to_dense() == product(a, b));
+    simple_check(invert(pa).to_dense() == invert(a));
+    auto l = pb;
+    l.lmul(pa);
+    simple_check(l == product(pa, pb));
+    simple_check(product(pa, invert(pa)) == pa.id());
+    simple_check((pa == pb) == (a == b));
+    simple_check((pa < pb) == (a < b));
+    for (auto x = T::start; x <= T::fin; ++x)
+      simple_check(pa.apply(x) == a.apply(x));
+  }
+}
+
+int test_packed_perms() {
+  cout << "Packed perm tests" << endl;
+  using UD5 = UnsignedDomain<1, 5>;
+  using PP = PackedPermutation<UD5>;
+
+  PP e;
+  Permutation<UD5> lg3{{1, 2}, {3, 4, 5}};
+  PP g3{{1, 2}, {3, 4, 5}};
+  simple_check(g3 == PP{lg3});
+  simple_check(g3.to_loops() == lg3);
+  simple_check(g3.apply(5) == 3);
+  simple_check(g3.smallest_moved() == 1);
+  simple_check(product(g3, invert(g3)) == e);
+  simple_check(perm_pow(g3, 6) == e);
+  simple_check(g3.hash() == PP{lg3}.hash());
+
+  check_packed_vs_dense<UD5>(100);
+  check_packed_vs_dense<UnsignedDomain<1, 16>>(100);
+  check_packed_vs_dense<UnsignedDomain<1, 17>>(100);
+  check_packed_vs_dense<UnsignedDomain<3, 34>>(100);
+
+  static_assert(std::is_same<FastPermutation<UnsignedDomain<1, 33>>,
+                             DensePermutation<UnsignedDomain<1, 33>>>::value,
+                "large domain shall pick dense permutation");
+  static_assert(std::is_same<FastPermutation<UnsignedRuntimeDomain<>>,
+                             DensePermutation<UnsignedRuntimeDomain<>>>::value,
+                "runtime domain shall pick dense permutation");
+
+  return 0;
+}
+
+int test_perm_batch() {
+  cout << "Perm batch tests" << endl;
+  using UD = UnsignedDomain<1, 37>;
+  using DP = DensePermutation<UD>;
+  mt19937 g(42);
+  vector<UD> img(UD::fin - UD::start + 1);
+  auto randperm = [&]() {
+    iota(img.begin(), img.end(), UD::start);
+    std::shuffle(img.begin(), img.end(), g);
+    return DP(img);
+  };
+
+  // odd sizes to cover both vector and scalar tails
+  for (size_t count : {0, 1, 7, 8, 17, 100}) {
+    vector<DP> ls, rs;
+    for (size_t k = 0; k < count; ++k) {
+      ls.push_back(randperm());
+      rs.push_back(randperm());
+    }
+    PermBatch<UD> lb(ls.begin(), ls.end()), rb(rs.begin(), rs.end());
+    simple_check(lb.size() == count);
+
+    auto pb = product(lb, rb);
+    for (size_t k = 0; k < count; ++k) {
+      simple_check(pb.get(k) == product(ls[k], rs[k]));
+      simple_check(pb.apply(k, 5) == product(ls[k], rs[k]).apply(5));
+    }
+
+    auto p = randperm();
+    auto rmb = lb;
+    rmb.rmul(p);
+    auto lmb = lb;
+    lmb.lmul(p);
+    lb.rmul(rb);
+    for (size_t k = 0; k < count; ++k) {
+      simple_check(rmb.get(k) == product(ls[k], p));
+      simple_check(lmb.get(k) == product(p, ls[k]));
+      simple_check(lb.get(k) == product(ls[k], rs[k]));
+    }
+  }
+
+  // loop-form permutations may be loaded too
+  Permutation<UD> lp{{1, 2, 3}, {10, 20}};
+  PermBatch<UD> b(3);
+  b.set(1, lp);
+  simple_check(b.get(0) == DP{});
+  simple_check(b.get(1).to_loops() == lp);
+
+  return 0;
+}
+
+int test_hashing() {
+  cout << "Hashing tests" << endl;
+  using UD5 = UnsignedDomain<1, 5>;
+  using DP = DensePermutation<UD5>;
+
+  // same permutation in loop and dense forms hashes the same
+  Permutation<UD5> g{{1, 2}, {3, 4, 5}};
+  Permutation<UD5> h{{1, 3}};
+  simple_check(g.hash() == DP{g}.hash());
+  simple_check(h.hash() == DP{h}.hash());
+  simple_check(g.hash() != h.hash());
+  simple_check(Permutation<UD5>{}.hash() == DP{}.hash());
+
+  // cached hash is dropped on modification
+  auto gh = product(g, h);
+  auto g2 = g;
+  g2.hash();
+  g2.rmul(h);
+  simple_check(g2.hash() == gh.hash());
+  simple_check(g2 == gh);
+  g2.inverse();
+  simple_check(g2.hash() == invert(gh).hash());
+  DP d{g};
+  d.hash();
+  d.lmul(DP{h});
+  simple_check(d.hash() == product(h, g).hash());
+
+  // shared const permutation may be hashed from many threads at once
+  const Permutation<UD5> shared{{1, 4}, {2, 5, 3}};
+  const auto copied = shared;
+  vector<size_t> seen(4);
+  parallel_for(4, 4, [&](size_t tid, size_t, size_t) {
+    seen[tid] = shared.hash();
+  });
+  for (auto x : seen)
+    simple_check(x == copied.hash());
+
+  // all 120 elements of Sym(5) have distinct hashes here
+  set<size_t> hashes;
+  vector<UD5> img{1, 2, 3, 4, 5};
+  do {
+    hashes.insert(DP{img}.hash());
+  } while (std::next_permutation(img.begin(), img.end()));
+  simple_check(hashes.size() == 120);
+
+  FlatSet<Permutation<UD5>> fs;
+  simple_check(fs.insert(g).second);
+  simple_check(!fs.insert(g).second);
+  simple_check(fs.insert(h).second);
+  simple_check(fs.size() == 2 && fs.count(g) == 1 && fs.count(gh) == 0);
+  simple_check(*fs.begin() == g);
+
+  FlatSet<unsigned> many;
+  for (unsigned i = 0; i < 10000; ++i)
+    many.insert(i * 7);
+  simple_check(many.size() == 10000);
+  for (unsigned i = 0; i < 10000; ++i)
+    simple_check(many.contains(i * 7) && !many.contains(i * 7 + 1));
+
+  FlatMap<DP, int> fm;
+  fm[DP{g}] = 1;
+  fm[DP{h}] += 2;
+  fm[DP{h}] += 2;
+  simple_check(fm.size() == 2);
+  simple_check(fm.at(DP{h}) == 4);
+  simple_check(fm.find(DP{gh}) == fm.end());
+  simple_check(!fm.emplace(DP{g}, 5).second && fm.at(DP{g}) == 1);
+
+  return 0;
+}
+
+int test_permio() {
+  cout << "Permutation io tests" << endl;
+  using UD6 = UnsignedDomain<1, 6>;
+  using P = Permutation<UD6>;
+  using DP = DensePermutation<UD6>;
+
+  // GAP list, own dump format and identity, tiny chunks cross tokens
+  stringstream gap;
+  gap << "[ (1,2,3), (4, 5)(1,6) ,\n()\n(1 6 3)(4 2)(5)\n";
+  P own{{1, 6, 3}, {4, 2}};
+  own.dump(gap);
+  PermReader<P> rd(gap, PermFormat::Cycles, 3);
+  vector<P> ps;
+  simple_check(rd.read_all(back_inserter(ps)) == 5);
+  simple_check(ps[0] == (P{{1, 2, 3}}));
+  simple_check(ps[1] == (P{{4, 5}, {1, 6}}));
+  simple_check(ps[2] == P{});
+  simple_check(ps[3] == own && ps[4] == own);
+
+  // round trip in both formats
+  vector<DP> dps;
+  vector<UD6> img{1, 2, 3, 4, 5, 6};
+  do {
+    dps.emplace_back(img);
+  } while (std::next_permutation(img.begin(), img.end()));
+
+  for (auto fmt : {PermFormat::Cycles, PermFormat::Images}) {
+    stringstream ss;
+    {
+      PermWriter<DP> wr(ss, fmt, 100);
+      wr.write(dps.begin(), dps.end());
+    }
+    PermReader<DP> rdd(ss, fmt, 7);
+    vector<DP> back;
+    rdd.read_all(back_inserter(back));
+    simple_check(back == dps);
+  }
+
+  stringstream cs;
+  {
+    PermWriter<P> wr(cs);
+    wr.write(P{{6, 3, 1}, {4, 2}});
+    wr.write(P{});
+  }
+  simple_check(cs.str() == "(1,6,3)(2,4)\n()\n");
+
+  stringstream is("6 4 1 2 5 3\n[1,2,3,4,5,6];[2 1 3 4 5 6]");
+  PermReader<P> ri(is, PermFormat::Images);
+  simple_check(*ri.next() == (P{{1, 6, 3}, {2, 4}}));
+  simple_check(*ri.next() == P{});
+  simple_check(*ri.next() == (P{{1, 2}}));
+  simple_check(!ri.next());
+
+  // malformed input
+  for (auto bad : {"(1,7)", "(1,2)(2,3)", "(1,2", "(1,,2)", "1 2 3"}) {
+    stringstream bs(bad);
+    PermReader<P> rb(bs);
+    bool thrown = false;
+    try {
+      while (rb.next())
+        ;
+    } catch (invalid_argument &) {
+      thrown = true;
+    }
+    simple_check(thrown);
+  }
+  for (auto bad : {"[1,2,3]", "[1,1,2,3,4,5]", "1 2 3 4 5 6 1"}) {
+    stringstream bs(bad);
+    PermReader<P> rb(bs, PermFormat::Images);
+    bool thrown = false;
+    try {
+      while (rb.next())
+        ;
+    } catch (invalid_argument &) {
+      thrown = true;
+    }
+    simple_check(thrown);
+  }
+
+  return 0;
+}
+
+int test_parallel_for() {
+  cout << "Parallel for tests" << endl;
+
+  // every index once, on pool workers, and nested calls do not block
+  for (int pass = 0; pass < 3; ++pass) {
+    vector<size_t> hits(1000, 0);
+    parallel_for(hits.size(), 4, [&](size_t, size_t beg, size_t fin) {
+      for (size_t i = beg; i != fin; ++i)
+        parallel_for(1, 2, [&](size_t, size_t, size_t) { hits[i] += 1; });
+    });
+    simple_check(all_of(hits.begin(), hits.end(),
+                        [](size_t h) { return h == 1; }));
+  }
+
+  bool thrown = false;
+  try {
+    parallel_for(100, 4, [](size_t tid, size_t, size_t) {
+      if (tid == 3)
+        throw invalid_argument("chunk 3");
+    });
+  } catch (invalid_argument &) {
+    thrown = true;
+  }
+  simple_check(thrown);
+
   return 0;
 }
 
@@ -243,6 +661,12 @@ int main() {
     test_simplify_loops();
     test_simple_perms();
     test_powers();
+    test_dense_perms();
+    test_packed_perms();
+    test_perm_batch();
+    test_hashing();
+    test_permio();
+    test_parallel_for();
   } catch (exception &e) {
     cout << "Failed: " << e.what() << endl;
     exit(-1);
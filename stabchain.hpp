@@ -0,0 +1,510 @@
+//------------------------------------------------------------------------------
+//
+//  Immutable stabilizer chain
+//
+//------------------------------------------------------------------------------
+//
+// StabChain<Perm> is read-only snapshot of (B, S, Delta*) from shreier_sims.
+// Everything is kept as zero-based uint32 image tables:
+//
+//   index[i * n + x]  number of point x in i-th basic orbit or npos
+//   uinv              for every level and orbit point, ubeta(x)^-1
+//   gens              strong generators of every level
+//
+// Sifting h is then one table lookup and one gather per level, done in place
+// on caller's buffer of n words. Nothing is changed by queries, so single
+// chain may be shared between any number of threads, and strip_all gives
+// each thread its own scratch buffer, allocated once per batch.
+//
+// Explicit inverse transversals cost sum |Delta[i]| * n words of memory
+//
+// All tables live in one buffer of uint32 words, which is also file format:
+//
+//   header   magic, version, header size, degree, T::start, number of levels,
+//            total orbit points P, total strong generators G (8 words)
+//   base     k words
+//   level    k + 1 words, level i orbit points start from level[i]
+//   glevel   k + 1 words, level i generators start from glevel[i]
+//   index    k * n words
+//   points   P words, orbit points in orbit order
+//   uinv     P * n words
+//   gens     G * n words
+//
+// Words are in native byte order, magic in wrong order means file came from
+// other architecture. map_file uses this buffer right from page cache, so
+// processes mapping same file share memory
+//
+// Buffers from read and map_file are untrusted: besides header, one linear
+// pass checks that every table entry is in range, levels are monotonic,
+// index and points agree and uinv and gens rows are permutations. So any
+// broken or hostile file gives runtime_error, never out of bounds access
+//
+//------------------------------------------------------------------------------
+
+#ifndef STABCHAIN_GUARD_
+#define STABCHAIN_GUARD_
+
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <memory>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "groups.hpp"
+#include "permbatch.hpp"
+
+namespace groups {
+
+using permutations::perm_from_images;
+using permutations::rmul_batch;
+
+template <typename Perm> class StabChain {
+  using T = typename Perm::value_type;
+
+  enum Header {
+    HMAGIC,
+    HVERSION,
+    HSIZE,
+    HDEGREE,
+    HSTART,
+    HLEVELS,
+    HPOINTS,
+    HGENS,
+    HWORDS
+  };
+
+  // keeps buffer alive, either vector or mapped file
+  std::shared_ptr<const void> holder_;
+  const uint32_t *data_ = nullptr;
+  size_t nwords_ = 0;
+
+  size_t degree_ = 0;
+  size_t nlevels_ = 0;
+  const uint32_t *base_ = nullptr;
+  const uint32_t *level_ = nullptr;
+  const uint32_t *glevel_ = nullptr;
+  const uint32_t *index_ = nullptr;
+  const uint32_t *points_ = nullptr;
+  const uint32_t *uinv_ = nullptr;
+  const uint32_t *gens_ = nullptr;
+
+public:
+  using value_type = Perm;
+  static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+  static constexpr uint32_t magic = 0x53544743; // "CGTS" in little endian
+  static constexpr uint32_t version = 1;
+
+  // ctors/dtors
+public:
+  // from result of shreier_sims, S and Delta* iterators go along base
+  template <typename BaseIt, typename GensIt, typename DeltaIt>
+  StabChain(BaseIt bstart, BaseIt bfin, GensIt sstart, DeltaIt dstart);
+
+  // from buffer written by save, throws runtime_error if it is broken
+  // validation is one linear pass over buffer
+  static StabChain read(std::istream &is);
+
+#if defined(__unix__) || defined(__APPLE__)
+  // maps file written by save, throws runtime_error if it is broken
+  // validation is one linear pass over mapped file
+  static StabChain map_file(const string &path);
+#endif
+
+  // selectors
+public:
+  size_t degree() const { return degree_; }
+  size_t nlevels() const { return nlevels_; }
+  T base(size_t i) const { return to_point(base_[i]); }
+  size_t orbit_size(size_t i) const { return level_[i + 1] - level_[i]; }
+  size_t ngens(size_t i) const { return glevel_[i + 1] - glevel_[i]; }
+
+  // point number num of i-th basic orbit, in orbit order
+  T orbit_point(size_t i, size_t num) const {
+    return to_point(points_[level_[i] + num]);
+  }
+
+  // strong generator j of level i
+  Perm gen(size_t i, size_t j) const;
+
+  // transversal element of level i for orbit point x
+  Perm ubeta(size_t i, T x) const;
+
+  // group order, throws overflow_error if it do not fit in 64 bits
+  uint64_t order() const;
+
+  // sift zero-based image table h of degree() words in place
+  // returns number of level where sifting stopped, nlevels() if all passed
+  size_t sift(uint32_t *h) const;
+
+  // true if g is in group, scratch is resized to degree() if needed
+  bool contains(const Perm &g, vector<uint32_t> &scratch) const;
+
+  bool contains(const Perm &g) const {
+    vector<uint32_t> scratch;
+    return contains(g, scratch);
+  }
+
+  // membership for all permutations in [gbeg, gend), res[k] is set to
+  // result for k-th one. res shall be random access to distinct objects
+  // (say vector<char>, not vector<bool>) since it is written concurrently
+  // nthreads = 0 means hardware concurrency
+  // returns number of group members
+  template <typename RandIt, typename ResIt>
+  size_t strip_all(RandIt gbeg, RandIt gend, ResIt res,
+                   size_t nthreads = 0) const;
+
+  // dump and serialization
+public:
+  // write whole buffer, it may be later read or mapped
+  void save(ostream &os) const;
+
+  // service functions
+private:
+  StabChain() = default;
+
+  // check header and set table pointers, throws runtime_error
+  void attach(std::shared_ptr<const void> holder, const uint32_t *data,
+              size_t nwords);
+
+  // check all tables, throws runtime_error
+  void validate() const;
+
+  // throws runtime_error if size of buffer do not fit in size_t
+  static size_t buffer_words(size_t n, size_t k, size_t np, size_t ng);
+
+  static T to_point(uint32_t x) { return static_cast<T>(T::start + x); }
+  const uint32_t *uinv(size_t i, uint32_t num) const {
+    return &uinv_[(level_[i] + size_t{num}) * degree_];
+  }
+  void load(const Perm &g, uint32_t *h) const;
+};
+
+//------------------------------------------------------------------------------
+//
+// implementation
+//
+//------------------------------------------------------------------------------
+
+template <typename Perm>
+template <typename BaseIt, typename GensIt, typename DeltaIt>
+StabChain<Perm>::StabChain(BaseIt bstart, BaseIt bfin, GensIt sstart,
+                           DeltaIt dstart)
+    : degree_(T::fin - T::start + 1) {
+  size_t nlevels = distance(bstart, bfin);
+  vector<uint32_t> base, level{0}, glevel{0}, points, uinv, gens;
+  vector<uint32_t> index(nlevels * degree_, npos);
+  vector<uint32_t> h(degree_);
+
+  for (size_t i = 0; i != nlevels; ++i, ++bstart, ++sstart, ++dstart) {
+    base.push_back(*bstart - T::start);
+    uint32_t num = 0;
+    for (auto &&x : *dstart) {
+      index[i * degree_ + (x - T::start)] = num++;
+      points.push_back(x - T::start);
+      load(invert(dstart->ubeta(x)), h.data());
+      uinv.insert(uinv.end(), h.begin(), h.end());
+    }
+    level.push_back(level.back() + num);
+
+    for (auto &&s : *sstart) {
+      load(s, h.data());
+      gens.insert(gens.end(), h.begin(), h.end());
+    }
+    glevel.push_back(glevel.back() + sstart->size());
+  }
+
+  auto buf = std::make_shared<vector<uint32_t>>(HWORDS);
+  auto &b = *buf;
+  b[HMAGIC] = magic;
+  b[HVERSION] = version;
+  b[HSIZE] = HWORDS;
+  b[HDEGREE] = degree_;
+  b[HSTART] = T::start;
+  b[HLEVELS] = nlevels;
+  b[HPOINTS] = points.size();
+  b[HGENS] = glevel.back();
+  for (auto *sect : {&base, &level, &glevel, &index, &points, &uinv, &gens})
+    b.insert(b.end(), sect->begin(), sect->end());
+  attach(buf, b.data(), b.size());
+}
+
+template <typename Perm>
+void StabChain<Perm>::attach(std::shared_ptr<const void> holder,
+                             const uint32_t *data, size_t nwords) {
+  if (nwords < HWORDS || data[HMAGIC] != magic)
+    throw runtime_error("Not a stabilizer chain or wrong byte order");
+  if (data[HVERSION] != version || data[HSIZE] != HWORDS)
+    throw runtime_error("Unsupported stabilizer chain version");
+  if (data[HDEGREE] != static_cast<size_t>(T::fin - T::start + 1) ||
+      data[HSTART] != static_cast<uint32_t>(T::start))
+    throw runtime_error("Stabilizer chain is for other domain");
+
+  size_t n = data[HDEGREE], k = data[HLEVELS];
+  size_t np = data[HPOINTS], ng = data[HGENS];
+  if (nwords != buffer_words(n, k, np, ng))
+    throw runtime_error("Stabilizer chain size mismatch");
+
+  holder_ = move(holder);
+  data_ = data;
+  nwords_ = nwords;
+  degree_ = n;
+  nlevels_ = k;
+  base_ = data + HWORDS;
+  level_ = base_ + k;
+  glevel_ = level_ + k + 1;
+  index_ = glevel_ + k + 1;
+  points_ = index_ + k * n;
+  uinv_ = points_ + np;
+  gens_ = uinv_ + np * n;
+
+  validate();
+}
+
+template <typename Perm>
+size_t StabChain<Perm>::buffer_words(size_t n, size_t k, size_t np,
+                                     size_t ng) {
+  constexpr size_t maxw = std::numeric_limits<size_t>::max() / sizeof(uint32_t);
+  size_t res = HWORDS;
+  auto add = [&res](size_t x, size_t y) {
+    if (y != 0 && x > maxw / y)
+      throw runtime_error("Stabilizer chain is too big");
+    if (res > maxw - x * y)
+      throw runtime_error("Stabilizer chain is too big");
+    res += x * y;
+  };
+  add(k, 1);
+  add(k + 1, 2);
+  add(k, n);
+  add(np, 1);
+  add(np, n);
+  add(ng, n);
+  return res;
+}
+
+template <typename Perm> void StabChain<Perm>::validate() const {
+  size_t n = degree_, k = nlevels_;
+  auto fail = [] {
+    throw runtime_error("Stabilizer chain tables are broken");
+  };
+
+  for (auto *lv : {level_, glevel_}) {
+    if (lv[0] != 0)
+      fail();
+    for (size_t i = 0; i != k; ++i)
+      if (lv[i + 1] < lv[i])
+        fail();
+  }
+  if (level_[k] != data_[HPOINTS] || glevel_[k] != data_[HGENS])
+    fail();
+
+  // every row shall be permutation of [0, n), stamp marks seen images
+  vector<size_t> stamp(n, 0);
+  size_t cur = 0;
+  auto check_row = [&](const uint32_t *row) {
+    ++cur;
+    for (size_t x = 0; x != n; ++x) {
+      if (row[x] >= n || stamp[row[x]] == cur)
+        fail();
+      stamp[row[x]] = cur;
+    }
+  };
+
+  // rows of level i fix earlier base points
+  auto check_fixed = [&](const uint32_t *row, size_t i) {
+    for (size_t j = 0; j != i; ++j)
+      if (row[base_[j]] != base_[j])
+        fail();
+  };
+
+  for (size_t i = 0; i != k; ++i)
+    if (base_[i] >= n)
+      fail();
+
+  for (size_t i = 0; i != k; ++i) {
+
+    // index and points are inverse to each other
+    size_t osize = orbit_size(i), nindexed = 0;
+    const uint32_t *idx = &index_[i * n];
+    for (size_t x = 0; x != n; ++x) {
+      if (idx[x] == npos)
+        continue;
+      if (idx[x] >= osize || points_[level_[i] + idx[x]] != x)
+        fail();
+      ++nindexed;
+    }
+    if (nindexed != osize)
+      fail();
+
+    // ubeta(x)^-1 sends x back to base point
+    for (uint32_t num = 0; num != osize; ++num) {
+      const uint32_t *u = uinv(i, num);
+      check_row(u);
+      check_fixed(u, i);
+      if (u[points_[level_[i] + num]] != base_[i])
+        fail();
+    }
+
+    for (size_t j = glevel_[i]; j != glevel_[i + 1]; ++j) {
+      check_row(&gens_[j * n]);
+      check_fixed(&gens_[j * n], i);
+    }
+  }
+}
+
+template <typename Perm>
+StabChain<Perm> StabChain<Perm>::read(std::istream &is) {
+  uint32_t hdr[HWORDS];
+  if (!is.read(reinterpret_cast<char *>(hdr), sizeof(hdr)))
+    throw runtime_error("Can not read stabilizer chain header");
+
+  // broken header is reported by attach, before reading anything else
+  size_t nwords = HWORDS;
+  if (hdr[HMAGIC] == magic && hdr[HVERSION] == version &&
+      hdr[HDEGREE] == static_cast<size_t>(T::fin - T::start + 1))
+    nwords = buffer_words(hdr[HDEGREE], hdr[HLEVELS], hdr[HPOINTS], hdr[HGENS]);
+
+  // buffer grows by chunks as data comes, so header, promising more than
+  // stream has, gives runtime_error and not huge allocation
+  constexpr size_t chunk = size_t(1) << 20;
+  auto buf = std::make_shared<vector<uint32_t>>(hdr, hdr + HWORDS);
+  while (buf->size() != nwords) {
+    size_t pos = buf->size();
+    buf->resize(pos + min(chunk, nwords - pos));
+    size_t len = (buf->size() - pos) * sizeof(uint32_t);
+    if (!is.read(reinterpret_cast<char *>(buf->data() + pos), len))
+      throw runtime_error("Stabilizer chain is truncated");
+  }
+
+  StabChain res;
+  res.attach(buf, buf->data(), nwords);
+  return res;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+template <typename Perm>
+StabChain<Perm> StabChain<Perm>::map_file(const string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw runtime_error("Can not open " + path);
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    throw runtime_error("Can not map " + path);
+  }
+  size_t len = st.st_size;
+  void *addr = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    throw runtime_error("Can not map " + path);
+
+  std::shared_ptr<const void> holder(addr, [len](const void *p) {
+    munmap(const_cast<void *>(p), len);
+  });
+  StabChain res;
+  res.attach(move(holder), static_cast<const uint32_t *>(addr),
+             len / sizeof(uint32_t));
+  return res;
+}
+#endif
+
+template <typename Perm> void StabChain<Perm>::save(ostream &os) const {
+  os.write(reinterpret_cast<const char *>(data_), nwords_ * sizeof(uint32_t));
+  if (!os)
+    throw runtime_error("Can not write stabilizer chain");
+}
+
+template <typename Perm>
+void StabChain<Perm>::load(const Perm &g, uint32_t *h) const {
+  for (size_t x = 0; x != degree_; ++x)
+    h[x] = g.apply(to_point(x)) - T::start;
+}
+
+template <typename Perm>
+Perm StabChain<Perm>::gen(size_t i, size_t j) const {
+  assert(j < ngens(i));
+  const uint32_t *g = &gens_[(glevel_[i] + j) * degree_];
+  vector<T> img(degree_);
+  for (size_t x = 0; x != degree_; ++x)
+    img[x] = to_point(g[x]);
+  return perm_from_images<Perm>(move(img));
+}
+
+template <typename Perm> Perm StabChain<Perm>::ubeta(size_t i, T x) const {
+  uint32_t num = index_[i * degree_ + (x - T::start)];
+  if (num == npos)
+    throw invalid_argument("Point is not in basic orbit");
+  const uint32_t *u = uinv(i, num);
+  vector<T> img(degree_);
+  for (size_t y = 0; y != degree_; ++y)
+    img[u[y]] = to_point(y);
+  return perm_from_images<Perm>(move(img));
+}
+
+template <typename Perm> uint64_t StabChain<Perm>::order() const {
+  uint64_t res = 1;
+  for (size_t i = 0; i != nlevels(); ++i) {
+    uint64_t sz = orbit_size(i);
+    if (res > std::numeric_limits<uint64_t>::max() / sz)
+      throw overflow_error("Group order do not fit in 64 bits");
+    res *= sz;
+  }
+  return res;
+}
+
+template <typename Perm> size_t StabChain<Perm>::sift(uint32_t *h) const {
+  for (size_t i = 0, k = nlevels(); i != k; ++i) {
+    uint32_t num = index_[i * degree_ + h[base_[i]]];
+    if (num == npos)
+      return i;
+    rmul_batch(h, uinv(i, num), degree_, 1);
+  }
+  return nlevels();
+}
+
+template <typename Perm>
+bool StabChain<Perm>::contains(const Perm &g,
+                               vector<uint32_t> &scratch) const {
+  scratch.resize(degree_);
+  uint32_t *h = scratch.data();
+  load(g, h);
+  if (sift(h) != nlevels())
+    return false;
+  for (size_t x = 0; x != degree_; ++x)
+    if (h[x] != x)
+      return false;
+  return true;
+}
+
+template <typename Perm>
+template <typename RandIt, typename ResIt>
+size_t StabChain<Perm>::strip_all(RandIt gbeg, RandIt gend, ResIt res,
+                                  size_t nthreads) const {
+  size_t n = gend - gbeg;
+  if (nthreads == 0)
+    nthreads = max<size_t>(1, thread::hardware_concurrency());
+  vector<size_t> counts(nthreads, 0);
+  parallel_for(n, nthreads, [&](size_t tid, size_t beg, size_t fin) {
+    vector<uint32_t> scratch(degree_);
+    size_t cnt = 0;
+    for (size_t k = beg; k != fin; ++k) {
+      bool isin = contains(gbeg[k], scratch);
+      res[k] = isin;
+      cnt += isin;
+    }
+    counts[tid] = cnt;
+  });
+  size_t total = 0;
+  for (auto c : counts)
+    total += c;
+  return total;
+}
+
+} // namespace groups
+
+#endif